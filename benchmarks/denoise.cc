@@ -0,0 +1,122 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Denoiser benchmark. Renders reference images of a soft shadow scene
+// and a depth of field scene with a large number of samples, then
+// renders them with a quarter of the samples and with a single
+// sample, with and without denoising, reporting render time and the
+// loss in quality relative to the reference.
+
+#include <cstdio>
+
+#include "rt/denoise.h"
+#include "rt/profiling.h"
+#include "rt/quality.h"
+#include "rt/rt.h"
+
+#include "./scenes.h"
+
+static const size_t width = 96;
+static const size_t height = 96;
+
+// Sample counts are divided by this amount for cheap renders.
+static const size_t sampleReduction = 4;
+
+// Render an image of a scene using the given number of soft light
+// samples, and as many depth of field samples if "dof" is set. Prints
+// the elapsed time and quality relative to the reference, if any.
+// Returns the rendered image.
+template <typename SceneType>
+static rt::DynamicImage *render(const char *const name,
+                                const size_t samples,
+                                const bool dof,
+                                const rt::Denoiser *const denoiser,
+                                const rt::DynamicImage *const reference) {
+        const SceneType *const test = new SceneType(samples);
+        const rt::Renderer renderer(test->scene, test->camera,
+                                    dof ? samples : 1, 5000, denoiser);
+        rt::DynamicImage *const image = new rt::DynamicImage(width, height);
+
+        rt::profiling::Timer t;
+        renderer.render(image);
+        const rt::Scalar runTime = t.elapsed();
+
+        if (reference) {
+                const rt::quality::Comparison result =
+                                rt::quality::compare(*reference, *image);
+                printf("%-24s %8lu %10.3f %10.2f %10.4f\n", name, samples,
+                       runTime, result.psnr, result.ssim);
+        } else {
+                printf("%-24s %8lu %10.3f %10s %10s\n", name, samples,
+                       runTime, "-", "-");
+        }
+
+        delete test;
+
+        return image;
+}
+
+// Benchmark the denoiser on a scene. "fullSamples" is the sample
+// count which cheap renders are compared against. If it is less than
+// "referenceSamples", it is rendered too.
+template <typename SceneType>
+static void benchmark(const char *const title,
+                      const size_t referenceSamples,
+                      const size_t fullSamples,
+                      const bool dof,
+                      const rt::Denoiser &denoiser) {
+        const size_t samples = fullSamples / sampleReduction;
+
+        printf("\n%s:\n\n", title);
+        printf("%-24s %8s %10s %10s %10s\n", "Render", "Samples",
+               "Time (s)", "PSNR (dB)", "SSIM");
+
+        rt::DynamicImage *const reference = render<SceneType>(
+            "Reference", referenceSamples, dof, nullptr, nullptr);
+        if (fullSamples < referenceSamples)
+                delete render<SceneType>("Full samples", fullSamples, dof,
+                                         nullptr, reference);
+        delete render<SceneType>("Full samples+denoise", fullSamples, dof,
+                                 &denoiser, reference);
+        delete render<SceneType>("Reduced samples", samples, dof,
+                                 nullptr, reference);
+        delete render<SceneType>("Reduced samples+denoise", samples, dof,
+                                 &denoiser, reference);
+        delete render<SceneType>("Single sample", 1, dof, nullptr,
+                                 reference);
+        delete render<SceneType>("Single sample+denoise", 1, dof,
+                                 &denoiser, reference);
+
+        delete reference;
+}
+
+int main() {
+        const rt::Denoiser denoiser;
+
+        printf("Rendering %lux%lu images ...\n", width, height);
+
+        // Soft shadows are the noise which the denoiser targets.
+        benchmark<PenumbraScene>("Soft shadows", 256, 16, false, denoiser);
+        // Depth of field noise is not visible to the denoiser's
+        // guides, which record only the first lens sample.
+        benchmark<DofScene>("Depth of field", 16, 16, true, denoiser);
+
+        return 0;
+}
@@ -0,0 +1,194 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Microbenchmarks of the core kernels. Each kernel is run in batches
+// over a cycle of random inputs. The batch size is calibrated so that
+// a batch takes at least 10 ms. The mean time per operation is
+// reported with a 95% confidence interval over the batches.
+//
+// Usage: micro [filter]
+//
+// If a filter is given, only kernels whose names contain it are run.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "rt/graphics.h"
+#include "rt/lights.h"
+#include "rt/math.h"
+#include "rt/objects.h"
+#include "rt/random.h"
+#include "rt/ray.h"
+
+#include "./scenes.h"
+
+// The number of inputs which each kernel cycles through. A power of
+// two, so that the input index is cheap to compute.
+static const size_t numInputs = 1024;
+// The minimum duration of a batch, and the number of batches.
+static const double minBatchSeconds = 0.01;
+static const size_t numBatches = 30;
+// Two-tailed 95% critical value of Student's t distribution, for
+// numBatches - 1 degrees of freedom.
+static const double tCritical = 2.045;
+
+// Prevent the compiler from optimising away the computation of a
+// value, without storing it.
+template<typename T>
+static inline void keep(const T &value) {
+        asm volatile("" : : "m"(value) : "memory");
+}
+
+// Run a batch of "iterations" operations, and return the elapsed
+// seconds.
+template<typename Kernel>
+static double batch(const Kernel &kernel, const size_t iterations) {
+        const auto start = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < iterations; i++)
+                keep(kernel(i & (numInputs - 1)));
+
+        const auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double>(end - start).count();
+}
+
+// Time a kernel, which is called with an input index, and print the
+// time per operation.
+template<typename Kernel>
+static void measure(const char *const name,
+                    const char *const filter,
+                    const Kernel &kernel) {
+        if (filter && !strstr(name, filter))
+                return;
+
+        // Find a batch size which takes long enough to time, warming
+        // caches and branch predictors in the process.
+        size_t iterations = numInputs;
+        while (batch(kernel, iterations) < minBatchSeconds)
+                iterations *= 2;
+
+        std::vector<double> times(numBatches);
+        for (auto &time : times)
+                time = batch(kernel, iterations) / iterations * 1e9;
+
+        double mean = 0;
+        for (const auto time : times)
+                mean += time;
+        mean /= numBatches;
+
+        double variance = 0;
+        for (const auto time : times)
+                variance += (time - mean) * (time - mean);
+        variance /= numBatches - 1;
+
+        const double interval = tCritical * std::sqrt(variance / numBatches);
+        const double fastest = *std::min_element(times.begin(), times.end());
+
+        printf("%-24s %10.2f %10.2f %7.1f%% %10.2f\n", name, mean,
+               interval, 100 * interval / mean, fastest);
+}
+
+int main(int argc, char **argv) {
+        const char *const filter = argc > 1 ? argv[1] : nullptr;
+        rt::UniformDistribution random(-1, 1);
+
+        // Random inputs.
+        std::vector<rt::Ray> rays;
+        std::vector<rt::Vector> points;
+        std::vector<rt::Colour> colours;
+        std::vector<rt::Matrix> matrices;
+        for (size_t i = 0; i < numInputs; i++) {
+                const rt::Vector direction(random(), random(), random());
+                rays.emplace_back(rt::Vector(random(), random(), -10),
+                                  direction.normalise());
+                points.emplace_back(random() * 100, random() * 100,
+                                    random() * 100);
+                colours.emplace_back(random() + .5, random() + .5,
+                                     random() + .5);
+                matrices.emplace_back(
+                    rt::Vector(random(), random(), random(), random()),
+                    rt::Vector(random(), random(), random(), random()),
+                    rt::Vector(random(), random(), random(), random()),
+                    rt::Vector(0, 0, 0, 1));
+        }
+
+        // Primitives.
+        const rt::Sphere sphere(rt::Vector(0, 0, 0), 1, 0);
+        const rt::Plane plane(rt::Vector(0, -1, 0), rt::Vector(0, 1, 0), 0);
+        const rt::CheckerBoard checkerBoard(rt::Vector(0, -1, 0),
+                                            rt::Vector(0, 1, 0), 10, 0, 1);
+
+        // Shading inputs: points on the in-focus sphere of the depth
+        // of field scene, seen from the camera. The scene is large, so
+        // keep it off the stack.
+        const auto dof = std::make_unique<const DofScene>();
+        const rt::Sphere &target =
+                        *static_cast<const rt::Sphere *>(dof->objects[1]);
+        const rt::Material &material =
+                        dof->scene.materials[target.material];
+        std::vector<rt::Vector> normals;
+        for (size_t i = 0; i < numInputs; i++)
+                normals.push_back(rt::Vector(random(), std::abs(random()),
+                                             -std::abs(random()))
+                                  .normalise());
+
+        printf("%-24s %10s %10s %8s %10s\n", "Kernel", "ns/op", "+/- 95%",
+               "", "min ns/op");
+
+        measure("Sphere::intersect", filter, [&](const size_t i) {
+                return sphere.Sphere::intersect(rays[i]);
+        });
+        measure("Plane::intersect", filter, [&](const size_t i) {
+                return plane.Plane::intersect(rays[i]);
+        });
+        measure("CheckerBoard::surface", filter, [&](const size_t i) {
+                return checkerBoard.CheckerBoard::surface(points[i]);
+        });
+        measure("SoftLight::shade", filter, [&](const size_t i) {
+                const rt::Vector &normal = normals[i];
+                const rt::Vector point = target.position +
+                                normal * target.radius;
+                return dof->scene.lights[0]->shade(
+                    point, normal, rt::Vector(0, 0, -1), &material,
+                    dof->scene.objects, 4);
+        });
+        measure("Matrix * Matrix", filter, [&](const size_t i) {
+                return matrices[i] * matrices[(i + 1) & (numInputs - 1)];
+        });
+        measure("Matrix * Vector", filter, [&](const size_t i) {
+                return matrices[i] * points[i];
+        });
+        measure("Vector::normalise", filter, [&](const size_t i) {
+                return points[i].normalise();
+        });
+        measure("UniformDistribution", filter, [&](const size_t) {
+                return random();
+        });
+        measure("Colour -> Pixel", filter, [&](const size_t i) {
+                return static_cast<rt::Pixel>(colours[i]);
+        });
+
+        return 0;
+}
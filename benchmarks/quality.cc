@@ -0,0 +1,99 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Speed/quality trade-off benchmark. Renders a reference image of a
+// depth of field scene with a large number of samples, then renders
+// it again with progressively cheaper settings, reporting performance
+// alongside the loss in quality relative to the reference.
+
+#include <cinttypes>
+#include <cstdio>
+
+#include "rt/profiling.h"
+#include "rt/quality.h"
+#include "rt/rt.h"
+
+#include "./scenes.h"
+
+static const size_t width = 96;
+static const size_t height = 96;
+
+// Number of depth of field samples for the reference render.
+static const size_t referenceDofSamples = 16;
+
+// Render an image with the given number of depth of field samples,
+// and print the elapsed time and ray throughput.
+static rt::DynamicImage *render(const rt::Scene &scene,
+                                const rt::Camera *const camera,
+                                const size_t numDofSamples,
+                                rt::Scalar *const runTime,
+                                rt::profiling::Counter *const rayRate) {
+        const rt::Renderer renderer(scene, camera, numDofSamples);
+        rt::DynamicImage *const image = new rt::DynamicImage(width, height);
+
+        rt::profiling::Timer t;
+
+        renderer.render(image);
+
+        *runTime = t.elapsed();
+        *rayRate = static_cast<rt::profiling::Counter>(
+            renderer.statistics().total(&rt::profiling::Counts::rays) /
+            *runTime);
+
+        return image;
+}
+
+int main() {
+        const DofScene dof;
+        const rt::Scene &scene = dof.scene;
+        const rt::Camera *const camera = dof.camera;
+
+        // Render reference image.
+        rt::Scalar runTime;
+        rt::profiling::Counter rayRate;
+        printf("Rendering %lux%lu reference with %lu DoF samples ...\n\n",
+               width, height, referenceDofSamples);
+        rt::DynamicImage *const reference = render(scene, camera,
+                                                   referenceDofSamples,
+                                                   &runTime, &rayRate);
+
+        printf("%-12s %10s %14s %10s %10s %10s\n", "DoF samples",
+               "Time (s)", "Rays/sec", "Speedup", "PSNR (dB)", "SSIM");
+        printf("%-12lu %10.3f %14" PRIu64 " %10.2f %10s %10s\n",
+               referenceDofSamples, runTime, rayRate, 1.0, "-", "-");
+
+        const rt::Scalar referenceTime = runTime;
+        for (size_t samples = referenceDofSamples / 2; samples; samples /= 2) {
+                rt::DynamicImage *const image = render(scene, camera, samples,
+                                                       &runTime, &rayRate);
+                const rt::quality::Comparison result =
+                                rt::quality::compare(*reference, *image);
+
+                printf("%-12lu %10.3f %14" PRIu64 " %10.2f %10.2f %10.4f\n",
+                       samples, runTime, rayRate, referenceTime / runTime,
+                       result.psnr, result.ssim);
+
+                delete image;
+        }
+
+        delete reference;
+
+        return 0;
+}
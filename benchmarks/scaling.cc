@@ -0,0 +1,85 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Scaling benchmark. Generates synthetic scenes of increasing size,
+// from 10 primitives up to a maximum, and reports the time taken to
+// generate and render each, along with the trace throughput.
+//
+// Usage: scaling [layout] [max count]
+//
+// The layout is one of spheres, grid, lights, or mirrors (default
+// spheres), and the maximum count defaults to 10^4.
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "rt/profiling.h"
+#include "rt/rt.h"
+#include "rt/scenegen.h"
+
+static const size_t width = 32;
+static const size_t height = 32;
+
+int main(int argc, char **argv) {
+        rt::scenegen::Parameters parameters;
+        size_t maxCount = 10000;
+
+        if (argc > 1 && !rt::scenegen::layout(argv[1], &parameters.layout)) {
+                fprintf(stderr, "fatal: unknown layout '%s'\n", argv[1]);
+                return 1;
+        }
+        if (argc > 2)
+                maxCount = strtoul(argv[2], nullptr, 10);
+
+        printf("Rendering %lux%lu images ...\n\n", width, height);
+        printf("%-10s %10s %12s %12s %14s %12s\n", "Count", "Objects",
+               "Generate (s)", "Render (s)", "Traces/sec",
+               "Traces/pixel");
+
+        for (size_t count = 10; count <= maxCount; count *= 10) {
+                parameters.count = count;
+
+                rt::profiling::Timer t;
+                const rt::SceneFile *const file =
+                                rt::scenegen::generate(parameters);
+                const rt::Scalar generateTime = t.elapsed();
+
+                const rt::Renderer renderer(*file->scene, file->camera,
+                                            file->dofSamples,
+                                            file->rayDepth);
+                rt::DynamicImage image(width, height);
+
+                rt::profiling::Timer r;
+                renderer.render(&image);
+                const rt::Scalar renderTime = r.elapsed();
+                const rt::profiling::Counter n =
+                                renderer.statistics().total(
+                                    &rt::profiling::Counts::traces);
+
+                printf("%-10lu %10lu %12.3f %12.3f %14.0f %12.2f\n", count,
+                       file->scene->objects.size(), generateTime, renderTime,
+                       n / renderTime,
+                       static_cast<double>(n) / (width * height));
+
+                delete file;
+        }
+
+        return 0;
+}
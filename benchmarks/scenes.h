@@ -0,0 +1,152 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BENCHMARKS_SCENES_H_
+#define BENCHMARKS_SCENES_H_
+
+// Scenes shared between benchmarks.
+
+#include <array>
+#include <utility>
+
+#include "rt/rt.h"
+
+// A depth of field test scene. Three spheres are staggered in depth so
+// that only the middle one is in focus, above a checkerboard and lit
+// by a soft light.
+class DofScene {
+ public:
+        explicit DofScene(const size_t lightSamples = 4)
+                : materials({
+                        table.add(rt::Material(rt::Colour(0xff0000),
+                                               0, 1, .2, 10, 0)),
+                        table.add(rt::Material(rt::Colour(0x00ff00),
+                                               0, 1, .2, 10, 0)),
+                        table.add(rt::Material(rt::Colour(0x0000ff),
+                                               0, 1, .2, 10, .5)),
+                        table.add(rt::Material(rt::Colour(0xffffff),
+                                               .1, .8, 0, 10, 0))
+                  }),
+                  objects({
+                        arena.make<rt::Sphere>(rt::Vector(-90, 0, -120), 40,
+                                               materials[0]),
+                        arena.make<rt::Sphere>(rt::Vector(0, 0, 0), 40,
+                                               materials[1]),
+                        arena.make<rt::Sphere>(rt::Vector(90, 0, 160), 40,
+                                               materials[2]),
+                        arena.make<rt::CheckerBoard>(rt::Vector(0, -60, 0),
+                                                     rt::Vector(0, 1, 0), 10,
+                                                     materials[3],
+                                                     materials[2])
+                  }),
+                  lights({
+                        arena.make<rt::SoftLight>(
+                            rt::Vector(-300, 400, -400),
+                            rt::Colour(0xffffff), 50, lightSamples)
+                  }),
+                  // Camera with a wide aperture.
+                  camera(new rt::Camera(rt::Vector(0, 60, -250),
+                                        rt::Vector(0, 0, 0),
+                                        50, 50, rt::Lens(50, 8))),
+                  scene(std::move(arena), std::move(table),
+                        rt::Objects(objects.begin(), objects.end()),
+                        rt::Lights(lights.begin(), lights.end())) {}
+
+        ~DofScene() {
+                delete camera;
+        }
+
+ private:
+        // Objects and lights are allocated from the arena, and
+        // materials added to the table. Both are then handed over to
+        // the scene.
+        rt::Arena arena;
+        rt::Materials table;
+
+ public:
+        const std::array<const rt::MaterialIndex, 4> materials;
+        const std::array<const rt::Object *const, 4> objects;
+        const std::array<const rt::Light *const, 1> lights;
+        const rt::Camera *const camera;
+        const rt::Scene scene;
+};
+
+// A soft shadow test scene. Two spheres above a white plane cast
+// shadows with wide penumbrae from a large soft light, viewed through
+// a pinhole camera so that light sampling is the only source of
+// noise.
+class PenumbraScene {
+ public:
+        explicit PenumbraScene(const size_t lightSamples = 4)
+                : materials({
+                        table.add(rt::Material(rt::Colour(0xff4040),
+                                               0, 1, .2, 10, 0)),
+                        table.add(rt::Material(rt::Colour(0x40ff40),
+                                               0, 1, .2, 10, 0)),
+                        table.add(rt::Material(rt::Colour(0xffffff),
+                                               .05, .9, 0, 10, 0))
+                  }),
+                  objects({
+                        arena.make<rt::Sphere>(rt::Vector(-50, 0, 0), 30,
+                                               materials[0]),
+                        arena.make<rt::Sphere>(rt::Vector(50, 10, 40), 40,
+                                               materials[1]),
+                        arena.make<rt::Plane>(rt::Vector(0, -30, 0),
+                                              rt::Vector(0, 1, 0),
+                                              materials[2])
+                  }),
+                  lights({
+                        arena.make<rt::SoftLight>(
+                            rt::Vector(0, 160, 80),
+                            rt::Colour(0xffffff), 60, lightSamples)
+                  }),
+                  // Pinhole camera.
+                  camera(new rt::Camera(rt::Vector(0, 150, -250),
+                                        rt::Vector(0, 0, 30),
+                                        50, 50, rt::Lens(50, 0))),
+                  scene(std::move(arena), std::move(table),
+                        rt::Objects(objects.begin(), objects.end()),
+                        rt::Lights(lights.begin(), lights.end())) {}
+
+        ~PenumbraScene() {
+                delete camera;
+        }
+
+ private:
+        rt::Arena arena;
+        rt::Materials table;
+
+ public:
+        const std::array<const rt::MaterialIndex, 3> materials;
+
+ private:
+#pragma GCC diagnostic push  // Ignore unused "_pad" variable.
+#pragma GCC diagnostic ignored "-Wunused-private-field"
+        // Padding bytes since there are an odd number of materials.
+        char _pad[4];
+#pragma GCC diagnostic pop  // Ignore unused "_pad" variable.
+
+ public:
+        const std::array<const rt::Object *const, 3> objects;
+        const std::array<const rt::Light *const, 1> lights;
+        const rt::Camera *const camera;
+        const rt::Scene scene;
+};
+
+#endif  // BENCHMARKS_SCENES_H_
@@ -0,0 +1,386 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// End-to-end rendering benchmark. Renders a fixed set of scenes at a
+// fixed resolution: the example scenes, and synthetic scenes which
+// vary object count, light samples, depth of field samples, and ray
+// depth. Each scene is rendered several times, keeping the fastest,
+// in a child process so that its peak resident set size can be
+// measured. The results are written as JSON, and compared against an
+// optional baseline written by a previous run, flagging regressions
+// beyond a tolerance.
+//
+// Usage: suite [-r repeats] [output] [baseline] [tolerance]
+//
+// Each scene is rendered 3 times unless "repeats" is given. The
+// output defaults to bench.json. The tolerance is a percentage,
+// defaulting to 10. Run from the repository root, so that the example
+// scenes can be found. Exits with status 2 if any regressions are
+// found.
+
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+
+#include "rt/options.h"
+#include "rt/profiling.h"
+#include "rt/rt.h"
+#include "rt/scenegen.h"
+
+// The output image scale factor, relative to the 36x36 film of every
+// scene.
+static const size_t scale = 2;
+
+// The number of times to render each scene.
+static size_t repeats = 3;
+
+// A scene to render. Scenes are loaded from "path" if set, else
+// generated.
+class Case {
+ public:
+        const char *name;
+        const char *path;
+        rt::scenegen::Layout layout;
+        size_t count;
+        size_t lightSamples;
+        size_t dofSamples;
+        size_t rayDepth;
+};
+
+static const Case cases[] = {
+        {"example2", "examples/example2.rt",
+         rt::scenegen::Layout::Spheres, 0, 0, 4, 100},
+        {"scene", "examples/scene.rt",
+         rt::scenegen::Layout::Spheres, 0, 0, 4, 100},
+        {"spheres-100", nullptr,
+         rt::scenegen::Layout::Spheres, 100, 1, 1, 100},
+        {"spheres-300", nullptr,
+         rt::scenegen::Layout::Spheres, 300, 1, 1, 100},
+        {"spheres-1000", nullptr,
+         rt::scenegen::Layout::Spheres, 1000, 1, 1, 100},
+        {"lights-8", nullptr,
+         rt::scenegen::Layout::Lights, 8, 1, 1, 100},
+        {"lights-8-samples-8", nullptr,
+         rt::scenegen::Layout::Lights, 8, 8, 1, 100},
+        {"grid-100-dof-1", nullptr,
+         rt::scenegen::Layout::Grid, 100, 1, 1, 100},
+        {"grid-100-dof-8", nullptr,
+         rt::scenegen::Layout::Grid, 100, 1, 8, 100},
+        {"mirrors-100-depth-2", nullptr,
+         rt::scenegen::Layout::Mirrors, 100, 1, 1, 2},
+        {"mirrors-100-depth-50", nullptr,
+         rt::scenegen::Layout::Mirrors, 100, 1, 1, 50}
+};
+
+// The measurements of a render.
+class Result {
+ public:
+        size_t width = 0;
+        size_t height = 0;
+        double seconds = 0;
+        double raysPerSecond = 0;
+        double tracesPerPixel = 0;
+        // Peak resident set size, in kilobytes.
+        double peakRss = 0;
+};
+
+// Load or generate a scene, and render it "repeats" times, measuring
+// the fastest render. Returns false if the scene cannot be loaded.
+static bool render(const Case &c, Result *const result) {
+        rt::SceneFile *file;
+
+        if (c.path) {
+                std::string error;
+                file = rt::SceneFile::load(c.path, &error);
+                if (file == nullptr) {
+                        fprintf(stderr, "fatal: %s\n", error.c_str());
+                        return false;
+                }
+        } else {
+                rt::scenegen::Parameters parameters;
+                parameters.layout = c.layout;
+                parameters.count = c.count;
+                parameters.lightSamples = c.lightSamples;
+                file = rt::scenegen::generate(parameters);
+        }
+
+        file->scale = scale;
+        result->width = file->width();
+        result->height = file->height();
+
+        for (size_t i = 0; i < repeats; i++) {
+                const rt::Renderer renderer(*file->scene, file->camera,
+                                            c.dofSamples, c.rayDepth);
+                rt::DynamicImage image(result->width, result->height);
+
+                rt::profiling::Timer t;
+                renderer.render(&image);
+                const double seconds = t.elapsed();
+                if (i && seconds >= result->seconds)
+                        continue;
+
+                const rt::profiling::Statistics &statistics =
+                                renderer.statistics();
+                result->seconds = seconds;
+                result->raysPerSecond =
+                                statistics.total(&rt::profiling::Counts::rays) /
+                                seconds;
+                result->tracesPerPixel = static_cast<double>(
+                                statistics.total(
+                                    &rt::profiling::Counts::traces)) /
+                                (result->width * result->height);
+        }
+
+        delete file;
+        return true;
+}
+
+// Render a scene in a child process, which reports its measurements
+// through a pipe. Returns false if the child fails.
+static bool measure(const Case &c, Result *const result) {
+        // Flush buffered output, so that the child does not repeat it.
+        fflush(nullptr);
+
+        int fds[2];
+        if (pipe(fds)) {
+                perror("fatal: pipe");
+                return false;
+        }
+
+        const pid_t pid = fork();
+        if (pid < 0) {
+                perror("fatal: fork");
+                return false;
+        }
+
+        if (!pid) {
+                close(fds[0]);
+                const bool ok = render(c, result) &&
+                                write(fds[1], result, sizeof(*result)) ==
+                                static_cast<ssize_t>(sizeof(*result));
+                close(fds[1]);
+                // Exit normally, so that the profiles of instrumented
+                // builds are written.
+                exit(ok ? 0 : 1);
+        }
+
+        close(fds[1]);
+        const bool received = read(fds[0], result, sizeof(*result)) ==
+                        static_cast<ssize_t>(sizeof(*result));
+        close(fds[0]);
+
+        int status;
+        struct rusage usage;
+        if (wait4(pid, &status, 0, &usage) != pid || !WIFEXITED(status) ||
+            WEXITSTATUS(status) || !received)
+                return false;
+
+        // Linux reports the maximum resident set size in kilobytes.
+        result->peakRss = usage.ru_maxrss;
+        return true;
+}
+
+// Read the value of "key" from a line of JSON written by
+// writeResult(). Returns false if the key is not present.
+static bool field(const std::string &line, const char *const key,
+                  double *const value) {
+        const std::string quoted = std::string("\"") + key + "\": ";
+        const size_t i = line.find(quoted);
+        if (i == std::string::npos)
+                return false;
+
+        *value = strtod(line.c_str() + i + quoted.size(), nullptr);
+        return true;
+}
+
+// Read the results of a previous run, one case per line. Returns
+// false if the file cannot be read.
+static bool readResults(const char *const path,
+                        std::map<std::string, Result> *const results) {
+        std::ifstream in(path);
+        if (!in)
+                return false;
+
+        const std::string prefix = "{\"name\": \"";
+        std::string line;
+        while (std::getline(in, line)) {
+                const size_t start = line.find(prefix);
+                if (start == std::string::npos)
+                        continue;
+                const size_t begin = start + prefix.size();
+                const size_t end = line.find('"', begin);
+                if (end == std::string::npos)
+                        continue;
+
+                Result &result = (*results)[line.substr(begin, end - begin)];
+                double width = 0, height = 0;
+                field(line, "width", &width);
+                field(line, "height", &height);
+                result.width = static_cast<size_t>(width);
+                result.height = static_cast<size_t>(height);
+                field(line, "seconds", &result.seconds);
+                field(line, "rays_per_second", &result.raysPerSecond);
+                field(line, "traces_per_pixel", &result.tracesPerPixel);
+                field(line, "peak_rss_kb", &result.peakRss);
+        }
+
+        return true;
+}
+
+static void writeResult(FILE *const out, const char *const name,
+                        const Result &result, const bool last) {
+        fprintf(out, "  {\"name\": \"%s\", \"width\": %lu, \"height\": %lu, "
+                "\"seconds\": %.6f, \"rays_per_second\": %.0f, "
+                "\"traces_per_pixel\": %.4f, \"peak_rss_kb\": %.0f}%s\n",
+                name, result.width, result.height, result.seconds,
+                result.raysPerSecond, result.tracesPerPixel,
+                result.peakRss, last ? "" : ",");
+}
+
+// Return the relative change from "baseline" to "value", as a
+// percentage.
+static double change(const double value, const double baseline) {
+        return baseline ? 100 * (value - baseline) / baseline : 0;
+}
+
+// Compare a result against its baseline, print the changes, and
+// return the number of metrics which regressed by more than
+// "tolerance" percent.
+static size_t compare(const Result &result, const Result &baseline,
+                      const double tolerance) {
+        // Changes which are regressions are positive: throughput
+        // falling, or time, work, or memory rising.
+        const double changes[] = {
+                -change(result.raysPerSecond, baseline.raysPerSecond),
+                change(result.tracesPerPixel, baseline.tracesPerPixel),
+                change(result.seconds, baseline.seconds),
+                change(result.peakRss, baseline.peakRss)
+        };
+
+        size_t regressions = 0;
+        for (const auto c : changes) {
+                const bool regressed = c > tolerance;
+                printf(" %+9.1f%%%s", c, regressed ? "!" : " ");
+                if (regressed)
+                        regressions++;
+        }
+
+        return regressions;
+}
+
+// Print the command line usage.
+static void usage(const char *const name) {
+        fprintf(stderr, "Usage: %s [-r repeats] [output] [baseline] "
+                "[tolerance]\n", name);
+}
+
+int main(int argc, char **argv) {
+        int option;
+        while ((option = getopt(argc, argv, "r:")) != -1) {
+                switch (option) {
+                case 'r':
+                        repeats = rt::options::count("-r", optarg);
+                        break;
+                default:
+                        usage(argv[0]);
+                        return 1;
+                }
+        }
+        argc -= optind - 1;
+        argv += optind - 1;
+
+        // Throughput and work are measured from the render's counts.
+        if (!rt::profiling::instrumentation) {
+                fprintf(stderr, "fatal: the benchmark suite requires "
+                        "INSTRUMENTATION >= 1\n");
+                return 1;
+        }
+
+        const char *const outputPath = argc > 1 ? argv[1] : "bench.json";
+        const char *const baselinePath = argc > 2 ? argv[2] : nullptr;
+        const double tolerance = argc > 3 ? strtod(argv[3], nullptr) : 10;
+
+        std::map<std::string, Result> baseline;
+        if (baselinePath && !readResults(baselinePath, &baseline))
+                printf("No baseline '%s', skipping comparison.\n\n",
+                       baselinePath);
+
+        FILE *const out = fopen(outputPath, "w");
+        if (out == nullptr) {
+                fprintf(stderr, "fatal: cannot write '%s'\n", outputPath);
+                return 1;
+        }
+        fprintf(out, "[\n");
+
+        printf("%-22s %10s %14s %12s %13s", "Scene", "Time (s)",
+               "Rays/sec", "Traces/pixel", "Peak RSS (KB)");
+        if (baseline.size())
+                printf(" %11s %11s %11s %11s", "Rays/sec", "Traces/px",
+                       "Time", "Peak RSS");
+        printf("\n");
+
+        const size_t numCases = sizeof(cases) / sizeof(cases[0]);
+        size_t regressions = 0;
+
+        for (size_t i = 0; i < numCases; i++) {
+                const Case &c = cases[i];
+                Result result;
+
+                if (!measure(c, &result)) {
+                        fprintf(stderr, "fatal: failed to render '%s'\n",
+                                c.name);
+                        fclose(out);
+                        return 1;
+                }
+
+                printf("%-22s %10.3f %14.0f %12.2f %13.0f", c.name,
+                       result.seconds, result.raysPerSecond,
+                       result.tracesPerPixel, result.peakRss);
+
+                const auto previous = baseline.find(c.name);
+                if (previous != baseline.end())
+                        regressions += compare(result, previous->second,
+                                               tolerance);
+                printf("\n");
+
+                writeResult(out, c.name, result, i == numCases - 1);
+        }
+
+        fprintf(out, "]\n");
+        fclose(out);
+
+        printf("\nWrote results to '%s'.\n", outputPath);
+        if (regressions) {
+                printf("%lu regressions beyond %.1f%% tolerance, marked "
+                       "with '!'.\n", regressions, tolerance);
+                return 2;
+        }
+
+        return 0;
+}
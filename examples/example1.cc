@@ -22,6 +22,8 @@
 #include "rt/rt.h"
 
 #include <array>
+#include <memory>
+#include <utility>
 
 static const size_t width = 512;
 static const size_t height = 512;
@@ -32,29 +34,35 @@ int main() {
         static const rt::Colour green = rt::Colour(0x00ff00);
         static const rt::Colour blue  = rt::Colour(0x0000ff);
 
+        // Create an arena to hold the objects and lights. The arena,
+        // material table, scene, and renderer are large, so they are
+        // kept off the stack.
+        const auto arena = std::make_unique<rt::Arena>();
+
         // Create materials.
-        const std::array<const rt::Material *const, 3> materials = {
-                new rt::Material(red, 0, 1, .2, 10, 0),
-                new rt::Material(green, 0, 1, .2, 10, 0),
-                new rt::Material(blue, 0, 1, .2, 10, 0)
+        const auto materials = std::make_unique<rt::Materials>();
+        const std::array<const rt::MaterialIndex, 3> _materials = {
+                materials->add(rt::Material(red, 0, 1, .2, 10, 0)),
+                materials->add(rt::Material(green, 0, 1, .2, 10, 0)),
+                materials->add(rt::Material(blue, 0, 1, .2, 10, 0))
         };
 
         // Create objects.
         const std::array<const rt::Sphere *const, 3> _objects = {
-                new rt::Sphere(rt::Vector(0,    50, 0), 50,
-                               materials[0]),
-                new rt::Sphere(rt::Vector(50,  -50, 0), 50,
-                               materials[1]),
-                new rt::Sphere(rt::Vector(-50, -50, 0), 50,
-                               materials[2])
+                arena->make<rt::Sphere>(rt::Vector(0,    50, 0), 50,
+                                        _materials[0]),
+                arena->make<rt::Sphere>(rt::Vector(50,  -50, 0), 50,
+                                        _materials[1]),
+                arena->make<rt::Sphere>(rt::Vector(-50, -50, 0), 50,
+                                        _materials[2])
         };
 
         // Create lights.
         const std::array<const rt::Light *const, 2> _lights = {
-                new rt::SoftLight(rt::Vector(-300,  400, -400),
-                                  rt::Colour(0xffffff)),
-                new rt::SoftLight(rt::Vector( 300, -200,  100),
-                                  rt::Colour(0x505050))
+                arena->make<rt::SoftLight>(rt::Vector(-300,  400, -400),
+                                           rt::Colour(0xffffff)),
+                arena->make<rt::SoftLight>(rt::Vector( 300, -200,  100),
+                                           rt::Colour(0x505050))
         };
 
         // Create camera.
@@ -69,13 +77,16 @@ int main() {
         const rt::Lights  lights(_lights.begin(),  _lights.end());
 
         // Create scene and renderer.
-        const rt::Scene scene(objects, lights);
-        const rt::Renderer renderer(scene, camera);
+        const auto scene = std::make_unique<rt::Scene>(
+            std::move(*arena), std::move(*materials), objects, lights);
+        const auto renderer = std::make_unique<rt::Renderer>(*scene,
+                                                             camera);
 
         rt::Image<width, height> *const image = new rt::Image<width, height>();
 
         // Run ray tracer.
-        rt::render<rt::Image<width, height>>(renderer, "render1.ppm", image);
+        rt::render<rt::Image<width, height>>(*renderer, "render1.ppm",
+                                             image);
 
         delete image;
 
@@ -0,0 +1,197 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RT_AOV_H_
+#define RT_AOV_H_
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "rt/buffers.h"
+#include "rt/math.h"
+#include "rt/profiling.h"
+
+namespace rt {
+
+// The first surface intersected by a primary ray.
+class Hit {
+ public:
+        // Distance along the ray to the intersection.
+        float distance;
+        // Surface normal at the point of intersection.
+        PackedVector normal;
+        // Material colour at the point of intersection.
+        Sample albedo;
+        // Index of the intersected object into Scene::objects, plus
+        // one.
+        uint32_t objectId;
+        // Index of the intersected surface's material into
+        // Scene::materials, plus one.
+        uint32_t materialId;
+
+        // Construct a hit with no intersection.
+        inline Hit() : distance(INFINITY), normal(Vector(0, 0, 0)),
+                       albedo(Colour()), objectId(0), materialId(0) {}
+};
+
+// A snapshot of the calling thread's profiling counters and the
+// time, used to attribute the cost of rendering to a pixel.
+class Cost {
+ public:
+        profiling::Counter traces;
+        profiling::Counter shadowRays;
+        profiling::Counter intersections;
+        std::chrono::high_resolution_clock::time_point time;
+
+        inline Cost()
+                : traces(profiling::counters::getThreadTraceCount()),
+                  shadowRays(profiling::counters::getThreadShadowRayCount()),
+                  intersections(
+                      profiling::counters::getThreadIntersectionCount()),
+                  time(std::chrono::high_resolution_clock::now()) {}
+};
+
+// Auxiliary per-pixel outputs, or "arbitrary output variables", which
+// Renderer::render() fills alongside the beauty image. Geometric
+// outputs are recorded from the primary ray through the centre of
+// each pixel, so cost a single extra write per pixel. Only the
+// enabled outputs are recorded.
+class AuxiliaryBuffers {
+ public:
+        // Output selection flags.
+        enum Output : unsigned {
+                Depth             = 1 << 0,
+                Normal            = 1 << 1,
+                ObjectId          = 1 << 2,
+                MaterialId        = 1 << 3,
+                SampleCount       = 1 << 4,
+                TraceCount        = 1 << 5,
+                Albedo            = 1 << 6,
+                ShadowRayCount    = 1 << 7,
+                IntersectionCount = 1 << 8,
+                Time              = 1 << 9,
+                All               = (1 << 10) - 1,
+                // The outputs which measure rendering cost.
+                CostOutputs       = (SampleCount | TraceCount |
+                                     ShadowRayCount | IntersectionCount |
+                                     Time)
+        };
+
+        explicit AuxiliaryBuffers(const size_t outputs = All);
+
+        // The enabled outputs.
+        const size_t outputs;
+
+        // Distance from the camera to the first hit, or INFINITY if
+        // the primary ray hits nothing.
+        Buffer<float> depth;
+        // Surface normal at the first hit.
+        Buffer<PackedVector> normal;
+        // Index of the first object hit into Scene::objects, plus
+        // one. Zero if the primary ray hits nothing.
+        Buffer<uint32_t> objectId;
+        // Index of the first surface hit's material into
+        // Scene::materials, plus one. Zero if the primary ray hits
+        // nothing.
+        Buffer<uint32_t> materialId;
+        // The number of camera samples taken for each pixel,
+        // including those taken by adaptive supersampling.
+        Buffer<uint32_t> sampleCount;
+        // The number of traces made for each pixel, including
+        // reflections.
+        Buffer<uint32_t> traceCount;
+        // Material colour at the first hit. Black if the primary ray
+        // hits nothing.
+        Buffer<Sample> albedo;
+        // The number of shadow rays cast for each pixel.
+        Buffer<uint32_t> shadowRayCount;
+        // The number of ray-object intersection tests made for each
+        // pixel, including those of shadow rays.
+        Buffer<uint32_t> intersectionCount;
+        // The number of nanoseconds spent rendering each pixel.
+        Buffer<uint32_t> time;
+
+        // Return whether an output is enabled.
+        auto inline enabled(const Output output) const {
+                return (outputs & output) != 0;
+        }
+
+        // Return whether all of a set of outputs are enabled.
+        auto inline provides(const size_t required) const {
+                return (outputs & required) == required;
+        }
+
+        // Resize all enabled outputs to the given number of pixels,
+        // and zero the cost outputs.
+        void resize(const size_t size);
+
+        // Record the first hit of a pixel's primary ray.
+        void inline record(const size_t pixel, const Hit &hit) {
+                if (enabled(Depth))
+                        depth[pixel] = hit.distance;
+                if (enabled(Normal))
+                        normal[pixel] = hit.normal;
+                if (enabled(ObjectId))
+                        objectId[pixel] = hit.objectId;
+                if (enabled(MaterialId))
+                        materialId[pixel] = hit.materialId;
+                if (enabled(Albedo))
+                        albedo[pixel] = hit.albedo;
+        }
+
+        // Add the cost incurred by the calling thread since "start" to
+        // a pixel's cost outputs.
+        void inline addCost(const size_t pixel, const Cost &start) {
+                if (!(outputs & CostOutputs))
+                        return;
+
+                const Cost end;
+
+                if (enabled(TraceCount))
+                        traceCount[pixel] += static_cast<uint32_t>(
+                            end.traces - start.traces);
+                if (enabled(ShadowRayCount))
+                        shadowRayCount[pixel] += static_cast<uint32_t>(
+                            end.shadowRays - start.shadowRays);
+                if (enabled(IntersectionCount))
+                        intersectionCount[pixel] += static_cast<uint32_t>(
+                            end.intersections - start.intersections);
+                if (enabled(Time))
+                        time[pixel] += static_cast<uint32_t>(
+                            std::chrono::duration_cast<
+                                std::chrono::nanoseconds>(
+                                    end.time - start.time).count());
+        }
+
+        // Write each enabled output as an image, using "path" as a
+        // template for the file names. For example, a path of
+        // "render.ppm" produces "render.depth.ppm",
+        // "render.normal.ppm", etc. Values are normalised for
+        // display, and costs are shown as heatmaps. Set "inverted" to
+        // match the beauty image's Y axis inversion.
+        void write(const std::string &path,
+                   const size_t width,
+                   const size_t height,
+                   const bool inverted = true) const;
+};
+
+}  // namespace rt
+
+#endif  // RT_AOV_H_
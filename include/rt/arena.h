@@ -0,0 +1,115 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RT_ARENA_H_
+#define RT_ARENA_H_
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace rt {
+
+// A region of memory which owns a set of objects, such as the
+// primitives, materials, and lights of a scene. Objects are packed
+// contiguously into blocks which grow geometrically in size, so
+// constructing n objects makes O(log n) allocator calls. All of the
+// objects are destroyed together with the arena, in reverse order of
+// construction.
+class Arena {
+ public:
+        Arena();
+
+        inline Arena(Arena &&other)
+                : blocks(other.blocks), cursor(other.cursor),
+                  end(other.end), finalisers(other.finalisers),
+                  capacity(other.capacity) {
+                other.blocks = nullptr;
+                other.cursor = other.end = nullptr;
+                other.finalisers = nullptr;
+                other.capacity = 0;
+        }
+
+        Arena(const Arena &) = delete;
+        Arena &operator=(const Arena &) = delete;
+
+        ~Arena();
+
+        // Construct an object in the arena.
+        template<typename T, typename... Args>
+        T *make(Args &&... args) {
+                // Objects with non-trivial destructors are preceded
+                // by a finaliser which destroys them.
+                Finaliser *const finaliser =
+                                std::is_trivially_destructible<T>::value ?
+                                nullptr : static_cast<Finaliser *>(
+                                    allocate(sizeof(Finaliser),
+                                             alignof(Finaliser)));
+                T *const object = new (allocate(sizeof(T), alignof(T)))
+                                T(std::forward<Args>(args)...);
+
+                if (finaliser) {
+                        finaliser->destroy = &destroy<T>;
+                        finaliser->object = object;
+                        finaliser->next = finalisers;
+                        finalisers = finaliser;
+                }
+
+                return object;
+        }
+
+        // Return the number of bytes allocated from the system.
+        auto inline size() const { return capacity; }
+
+ private:
+        // A block of memory, followed by its contents.
+        class Block {
+         public:
+                Block *next;
+                size_t size;
+        };
+
+        // An entry in the list of objects to destroy.
+        class Finaliser {
+         public:
+                void (*destroy)(void *);
+                void *object;
+                Finaliser *next;
+        };
+
+        template<typename T>
+        static void destroy(void *const object) {
+                static_cast<T *>(object)->~T();
+        }
+
+        // Return uninitialised memory from the current block,
+        // starting a new block if required.
+        void *allocate(const size_t size, const size_t alignment);
+
+        Block *blocks;
+        char *cursor;  // Free space in the current block.
+        char *end;
+        Finaliser *finalisers;
+        size_t capacity;
+};
+
+}  // namespace rt
+
+#endif  // RT_ARENA_H_
@@ -0,0 +1,147 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RT_BUFFERS_H_
+#define RT_BUFFERS_H_
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+
+#include "rt/graphics.h"
+#include "rt/math.h"
+#include "rt/restrict.h"
+
+namespace rt {
+
+// A single precision R,G,B colour sample. Used for compact storage of
+// intermediate render results, where the full precision of Colour is
+// not required.
+class Sample {
+ public:
+        float r, g, b;
+
+        Sample() = default;
+
+        explicit inline Sample(const Colour &c)
+                        : r(static_cast<float>(c.r)),
+                          g(static_cast<float>(c.g)),
+                          b(static_cast<float>(c.b)) {}
+
+        // Explicit cast operation from Sample -> Colour.
+        explicit inline operator Colour() const {
+                return Colour(r, g, b);
+        }
+
+        // Return the sum difference between the r,g,b colour
+        // components.
+        auto inline diff(const Sample &rhs) const {
+                return (std::fabs(rhs.r - r) + std::fabs(rhs.g - g) +
+                        std::fabs(rhs.b - b));
+        }
+};
+
+// A single precision vector, used for compact storage of per-pixel
+// directions.
+class PackedVector {
+ public:
+        float x, y, z;
+
+        PackedVector() = default;
+
+        explicit inline PackedVector(const Vector &v)
+                        : x(static_cast<float>(v.x)),
+                          y(static_cast<float>(v.y)),
+                          z(static_cast<float>(v.z)) {}
+};
+
+// A reusable, cache line aligned array of trivial elements. Shrinking
+// or resizing a buffer to its current size never touches the
+// allocator, so a buffer can be reused across renders without
+// allocating memory. Element values are not initialised.
+template<typename T>
+class Buffer {
+        static_assert(std::is_trivial<T>::value,
+                      "Buffer elements must be trivial types");
+
+ public:
+        // The alignment of buffer memory, in bytes.
+        static constexpr size_t alignment = 64;
+
+        inline Buffer() : _data(nullptr), _size(0), _capacity(0) {}
+
+        inline ~Buffer() {
+                free(_data);
+        }
+
+        Buffer(const Buffer &) = delete;
+        Buffer &operator=(const Buffer &) = delete;
+
+        // Set the number of elements in the buffer, reallocating only
+        // if the requested size exceeds the current capacity.
+        void resize(const size_t size) {
+                if (size > _capacity) {
+                        void *memory = nullptr;
+                        const size_t bytes = size * sizeof(T);
+
+                        free(_data);
+                        _data = nullptr;
+                        _capacity = 0;
+                        if (posix_memalign(&memory, alignment, bytes))
+                                throw std::bad_alloc();
+                        _data = static_cast<T *>(memory);
+                        _capacity = size;
+                }
+                _size = size;
+        }
+
+        auto inline operator[](const size_t i) -> T & {
+                return _data[i];
+        }
+
+        auto inline operator[](const size_t i) const -> const T & {
+                return _data[i];
+        }
+
+        auto inline data() {
+                return _data;
+        }
+
+        auto inline data() const {
+                return static_cast<const T *>(_data);
+        }
+
+        auto inline size() const {
+                return _size;
+        }
+
+        auto inline capacity() const {
+                return _capacity;
+        }
+
+ private:
+        T *restrict _data;
+        size_t _size;
+        size_t _capacity;
+};
+
+}  // namespace rt
+
+#endif  // RT_BUFFERS_H_
@@ -46,6 +46,7 @@ class Lens {
 class Camera {
  public:
         const Vector position;
+        const Vector lookAt;
         const Vector direction;
         const Vector filmBack;
         const Vector right;
@@ -61,6 +62,7 @@ class Camera {
                       const Scalar _height,
                       const Lens   &_lens)
                 : position(_position),
+                  lookAt(_lookAt),
                   direction((_lookAt - _position).normalise()),
                   filmBack(_position - (_lookAt - _position).normalise()
                            * _lens.focalLength),
@@ -0,0 +1,174 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RT_CHUNKS_H_
+#define RT_CHUNKS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "rt/camera.h"
+#include "rt/denoise.h"
+#include "rt/lights.h"
+#include "rt/math.h"
+#include "rt/objects.h"
+#include "rt/renderer.h"
+#include "rt/scene.h"
+
+namespace rt {
+
+/*
+ * Out-of-core rendering of chunked binary scenes (see
+ * rt/sceneformat.h). The spheres of a chunk are read from disk when
+ * a ray first passes through the chunk's bounding box, and are kept
+ * in a least recently used cache of a fixed size. All other objects,
+ * and the lights and materials, are always resident.
+ */
+
+// The spheres of a loaded chunk.
+class Chunk {
+ public:
+        std::vector<Sphere> spheres;
+};
+
+// Chunk cache statistics.
+class ChunkStats {
+ public:
+        uint64_t hits = 0;        // Lookups of a resident chunk.
+        uint64_t misses = 0;      // Lookups which loaded a chunk.
+        uint64_t evictions = 0;   // Chunks dropped to make space.
+        uint64_t bytesRead = 0;   // Bytes read from disk.
+        uint64_t peakBytes = 0;   // Largest resident size.
+        uint64_t rejected = 0;    // Spheres which could not be loaded.
+
+        // Return the fraction of lookups which found the chunk
+        // resident.
+        Scalar hitRate() const;
+};
+
+// A cache of the chunks of a binary scene file, which are loaded on
+// demand. Chunks are evicted in least recently used order to keep
+// the size of the resident spheres within a capacity, although a
+// chunk which is still in use by a ray stays in memory until the ray
+// releases it. Safe for concurrent use.
+class ChunkCache {
+ public:
+        // The bounds and file location of a chunk.
+        class Entry {
+         public:
+                Vector min;
+                Vector max;
+                uint64_t offset;  // Byte offset of the chunk's spheres.
+                uint64_t first;   // Index of the chunk's first sphere.
+                uint64_t count;   // Number of spheres.
+        };
+
+        // Create a cache for the chunks of an open file, taking
+        // ownership of the file descriptor. Spheres which refer to a
+        // material index of "materialCount" or above are rejected.
+        ChunkCache(const int fd,
+                   std::vector<Entry> &&entries,
+                   const size_t capacity,
+                   const size_t materialCount);
+
+        ChunkCache(const ChunkCache &) = delete;
+        ChunkCache &operator=(const ChunkCache &) = delete;
+
+        // Close the file.
+        ~ChunkCache();
+
+        // The chunks of the file.
+        const std::vector<Entry> entries;
+
+        // The maximum resident size, in bytes.
+        const size_t capacity;
+
+        // Return a chunk, reading it from disk if it is not resident.
+        std::shared_ptr<const Chunk> get(const size_t index) const;
+
+        // Return the statistics so far.
+        ChunkStats stats() const;
+
+ private:
+        // A resident chunk, and its position in the LRU list.
+        class Slot {
+         public:
+                std::shared_ptr<const Chunk> chunk;
+                std::list<size_t>::iterator recent;
+        };
+
+        // Read a chunk from disk.
+        std::shared_ptr<const Chunk> read(const size_t index) const;
+
+        const size_t materialCount;
+        const int fd;
+
+#pragma GCC diagnostic push  // Ignore unused "_pad" variable.
+#pragma GCC diagnostic ignored "-Wunused-private-field"
+        // Padding bytes since the file descriptor is only four bytes.
+        char _pad[4];
+#pragma GCC diagnostic pop  // Ignore unused "_pad" variable.
+
+        mutable std::mutex mutex;
+        // Slots for every chunk, empty if not resident.
+        mutable std::vector<Slot> slots;
+        // Indices of resident chunks, most recently used first.
+        mutable std::list<size_t> recent;
+        // Current resident size, in bytes.
+        mutable size_t residentBytes;
+        mutable ChunkStats counters;
+};
+
+// A renderer for scenes whose spheres are held in a ChunkCache, in
+// addition to the resident objects of the scene. Rays visit the
+// chunks whose bounds they cross in order of distance, and stop at
+// the first chunk beyond the closest intersection found so far, so
+// chunks hidden behind nearer geometry are not loaded.
+class ChunkedRenderer : public Renderer {
+ public:
+        ChunkedRenderer(const Scene &_scene,
+                        const ChunkCache &_chunks,
+                        const rt::Camera *const restrict _camera,
+                        const size_t _numDofSamples = 1,
+                        const size_t _maxRayDepth   = 5000,
+                        const Denoiser *const _denoiser = nullptr);
+
+        const ChunkCache &chunks;
+
+ protected:
+        virtual Colour trace(const Ray &ray,
+                             const Quality &quality,
+                             const unsigned int depth = 0,
+                             Hit *const restrict hit = nullptr) const;
+
+ private:
+        // The scene's lights, or nullptr for lights which are not
+        // soft lights.
+        std::vector<const SoftLight *> lights;
+        // The number of spheres in the chunks.
+        size_t sphereCount;
+};
+
+}  // namespace rt
+
+#endif  // RT_CHUNKS_H_
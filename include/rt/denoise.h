@@ -0,0 +1,88 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RT_DENOISE_H_
+#define RT_DENOISE_H_
+
+#include "rt/aov.h"
+#include "rt/buffers.h"
+#include "rt/math.h"
+#include "rt/restrict.h"
+
+namespace rt {
+
+// An edge-avoiding a-trous wavelet denoiser. Smooths the noise caused
+// by low soft light sample counts, using the first hit depth, normal,
+// and albedo of each pixel to avoid blurring across geometric and
+// texture edges. Each iteration applies a sparse 5x5 filter with
+// double the previous spacing, so that large regions can be smoothed
+// cheaply. Depth of field blur is not captured by the guides, which
+// record only the first lens sample, so the filter smears defocused
+// edges instead of removing their noise.
+//
+// See: Dammertz, H., Sewtz, D., Hanika, J., & Lensch, H. (2010).
+// Edge-avoiding a-trous wavelet transform for fast global
+// illumination filtering. In HPG '10.
+class Denoiser {
+ public:
+        // The auxiliary outputs which the denoiser requires.
+        static constexpr size_t requiredOutputs = (AuxiliaryBuffers::Depth |
+                                                   AuxiliaryBuffers::Normal |
+                                                   AuxiliaryBuffers::Albedo);
+
+        inline explicit Denoiser(const size_t _iterations = 1,
+                                 const Scalar _colourSigma = .3,
+                                 const Scalar _normalPower = 64,
+                                 const Scalar _depthSigma = .05,
+                                 const Scalar _albedoSigma = .1)
+                : iterations(_iterations),
+                  colourSigma(_colourSigma),
+                  normalPower(_normalPower),
+                  depthSigma(_depthSigma),
+                  albedoSigma(_albedoSigma) {}
+
+        // Denoiser configuration:
+
+        // The number of filter iterations. The filter footprint is
+        // 2^(iterations + 2) pixels wide:
+        const size_t iterations;
+        // Sensitivity to colour differences. Halved for each
+        // iteration:
+        const Scalar colourSigma;
+        // Sensitivity to normal differences. Higher values preserve
+        // more geometric edges:
+        const Scalar normalPower;
+        // Sensitivity to depth differences, relative to depth:
+        const Scalar depthSigma;
+        // Sensitivity to albedo differences:
+        const Scalar albedoSigma;
+
+        // Denoise an image in place, using "scratch" as temporary
+        // storage. "guides" must have the required outputs enabled,
+        // and describe the same image.
+        void denoise(Buffer<Sample> *const restrict image,
+                     Buffer<Sample> *const restrict scratch,
+                     const AuxiliaryBuffers &guides,
+                     const size_t width,
+                     const size_t height) const;
+};
+
+}  // namespace rt
+
+#endif  // RT_DENOISE_H_
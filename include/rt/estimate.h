@@ -0,0 +1,100 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RT_ESTIMATE_H_
+#define RT_ESTIMATE_H_
+
+#include <cstddef>
+
+#include "rt/chunks.h"
+#include "rt/math.h"
+#include "rt/renderer.h"
+#include "rt/scene.h"
+
+namespace rt {
+
+// Statistics of the contents of a scene.
+class SceneStats {
+ public:
+        // Primitive counts by type.
+        size_t spheres = 0;
+        size_t planes = 0;
+        size_t checkerBoards = 0;
+        size_t otherObjects = 0;
+
+        size_t materials = 0;
+        size_t lights = 0;
+        // The number of shadow rays cast to shade a point, at full
+        // quality.
+        size_t lightSamples = 0;
+        // The number of objects with a reflective material, and the
+        // highest reflectivity.
+        size_t mirrors = 0;
+        Scalar maxReflectivity = 0;
+
+        // The bounds of the spheres. Planes are unbounded.
+        Scalar min[3] = { 0, 0, 0 };
+        Scalar max[3] = { 0, 0, 0 };
+};
+
+// Return the statistics of a scene, including the spheres of its
+// chunks, if any.
+SceneStats statistics(const Scene &scene,
+                      const ChunkCache *const chunks = nullptr);
+
+// A prediction of the cost of a render, extrapolated from a sparse
+// sample of its pixels. Traces, shadow rays, intersections, and
+// reflection depth are counted, so they are zero when instrumentation
+// is compiled out. See RT_INSTRUMENTATION.
+class Estimate {
+ public:
+        size_t pixels = 0;   // Pixels in the image.
+        size_t sampled = 0;  // Pixels traced for the estimate.
+        Scalar sampleSeconds = 0;  // Time taken by the sample.
+
+        // Means over the sampled pixels:
+        Scalar samplesPerPixel = 0;  // Points, including supersamples.
+        Scalar tracesPerPixel = 0;
+        Scalar shadowRaysPerPixel = 0;
+        Scalar intersectionsPerPixel = 0;
+        // The mean number of reflections of a camera ray.
+        Scalar reflectionDepth = 0;
+
+        // Extrapolated totals for the image. Time is in core
+        // seconds, as if rendered by a single thread.
+        Scalar traces = 0;
+        Scalar shadowRays = 0;
+        Scalar intersections = 0;
+        Scalar seconds = 0;
+};
+
+// Estimate the cost of rendering an image of the given size, by
+// rendering at most "count" pixels spread evenly over the image, at
+// full quality. Each sampled pixel also samples its neighbours to
+// decide whether to supersample, which is not counted in its cost,
+// so the estimate takes roughly 9 times as long as rendering the
+// sampled pixels alone.
+Estimate estimate(const Renderer &renderer,
+                  const size_t width,
+                  const size_t height,
+                  const size_t count = 256);
+
+}  // namespace rt
+
+#endif  // RT_ESTIMATE_H_
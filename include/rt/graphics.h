@@ -70,15 +70,15 @@ class Colour {
 
         // Constructor for specifying colours as 32 bit hex
         // string. E.g. 0xff00aa.
-        explicit inline Colour(const int hex)
+        explicit constexpr Colour(const int hex)
                         : r((hex >> 16) / 255.),
                         g(((hex >> 8) & 0xff) / 255.),
                         b((hex & 0xff) / 255.) {}
 
         // Contructor: C = (r,g,b)
-        explicit inline Colour(const float _r = 0,
-                               const float _g = 0,
-                               const float _b = 0)
+        explicit constexpr Colour(const float _r = 0,
+                                  const float _g = 0,
+                                  const float _b = 0)
                         : r(_r), g(_g), b(_b) {}
 
         // Constructor from (h,s,l) definition.
@@ -156,6 +156,22 @@ class HSL {
         explicit HSL(const Colour &c);
 };
 
+// Map a scalar in the range [0,1] to a "heat" colour which ramps from
+// black, through blue, red, and yellow, to white. Used to visualise
+// per-pixel data.
+Colour inline heat(const Scalar x) {
+        const Scalar v = clamp(x) * 4;
+
+        if (v < 1)
+                return Colour(0, 0, v);
+        else if (v < 2)
+                return Colour(v - 1, 0, 2 - v);
+        else if (v < 3)
+                return Colour(1, v - 2, 0);
+        else
+                return Colour(1, 1, v - 3);
+}
+
 }  // namespace rt
 
 #endif  // RT_GRAPHICS_H_
@@ -20,6 +20,9 @@
 #ifndef RT_IMAGE_H_
 #define RT_IMAGE_H_
 
+#include <array>
+#include <iostream>
+#include <string>
 #include <vector>
 
 #include "rt/graphics.h"
@@ -44,6 +47,22 @@ inline size_t y(const size_t index, const size_t width) {
         return index / width;
 }
 
+// Apply gamma correction to a colour and convert it to pixel data.
+inline Pixel correct(const Colour &value, const Colour &gamma) {
+        const Colour corrected = Colour(std::pow(value.r, gamma.r),
+                                        std::pow(value.g, gamma.g),
+                                        std::pow(value.b, gamma.b));
+
+        // Explicitly cast colour to pixel data.
+        return static_cast<Pixel>(corrected);
+}
+
+// Write pixel data to an output stream as a plain PPM image.
+void writePPM(std::ostream &out,
+              const Pixel *const restrict data,
+              const size_t width,
+              const size_t height);
+
 }  // namespace image
 
 // A rendered image.
@@ -97,25 +116,8 @@ class Image {
 
         friend auto& operator<<(std::ostream& out,
                                 const Image<_width, _height> &image) {
-                // Print PPM header.
-
-                // Magic number:
-                out << "P3" << std::endl;
-                // Image dimensions:
-                out << image.width << " " << image.height << std::endl;
-                // Max colour value:
-                out << unsigned(Pixel::ComponentMax) << std::endl;
-
-                // Iterate over each point in the image, writing pixel data.
-                for (size_t i = 0; i < image.size; i++) {
-                        const Pixel pixel = image.data[i];
-                        out << pixel << " ";
-
-                        // Add newline at the end of each row:
-                        if (!i % image.width)
-                                out << std::endl;
-                }
-
+                image::writePPM(out, image.data.data(),
+                                image.width, image.height);
                 return out;
         }
 
@@ -148,11 +150,6 @@ Image<_width, _height>::Image(const Scalar _saturation,
 template<size_t width, size_t height>
 void Image<width, height>::_set(const size_t i,
                                 const Colour &value) {
-        // Apply gamma correction.
-        Colour corrected = Colour(std::pow(value.r, gamma.r),
-                                  std::pow(value.g, gamma.g),
-                                  std::pow(value.b, gamma.b));
-
         // TODO: Fix strange aliasing effect as a result of
         // RGB -> HSL -> RGB conversion.
         // HSL hsl(corrected);
@@ -163,10 +160,93 @@ void Image<width, height>::_set(const size_t i,
         // Convert back to RGB colour.
         // corrected = Colour(hsl);
 
-        // Explicitly cast colour to pixel data.
-        data[i] = static_cast<Pixel>(corrected);
+        // Apply gamma correction.
+        data[i] = image::correct(value, gamma);
 }
 
+// A rendered image, with dimensions which are set at runtime rather
+// than compile time. Provides the same interface as Image, so can be
+// passed to Renderer::render().
+class DynamicImage {
+ public:
+        std::vector<Pixel> data;
+        const size_t width;
+        const size_t height;
+        const size_t size;
+        const Scalar saturation;
+        const Colour gamma;
+        const bool inverted;
+
+        DynamicImage(const size_t width,
+                     const size_t height,
+                     const Scalar saturation = 1,
+                     const Colour gamma = Colour(1, 1, 1),
+                     const bool inverted = true);
+
+        ~DynamicImage() {}
+
+        // [x,y] = value
+        auto inline set(const size_t x,
+                        const size_t y,
+                        const Colour &value) {
+                // Apply Y axis inversion if needed.
+                const size_t row = inverted ? height - 1 - y : y;
+                // Convert 2D coordinates to flat array index and
+                // apply gamma correction.
+                data[image::index(x, row, width)] =
+                                image::correct(value, gamma);
+        }
+
+        // [index] = value
+        auto inline set(const size_t index,
+                        const Colour &value) {
+                const size_t x = image::x(index, width);
+                const size_t y = image::y(index, width);
+
+                set(x, y, value);
+        }
+
+        auto index(const size_t x, const size_t y) const {
+                return image::index(x, y, width);
+        }
+
+        auto x(const size_t index) const {
+                return image::x(index, width);
+        }
+
+        auto y(const size_t index) const {
+                return image::y(index, width);
+        }
+
+        friend auto& operator<<(std::ostream& out,
+                                const DynamicImage &image) {
+                image::writePPM(out, image.data.data(),
+                                image.width, image.height);
+                return out;
+        }
+
+ private:
+#pragma GCC diagnostic push  // Ignore unused "_pad" variable.
+#pragma GCC diagnostic ignored "-Wunused-private-field"
+        // Padding bytes since the "inverted" member bool is only a
+        // single byte.
+        char _pad[7];
+#pragma GCC diagnostic pop  // Ignore unused "_pad" variable.
+};
+
+namespace image {
+
+// Return the path of an output which accompanies the image at
+// "path", e.g. "render.depth.ppm" for "render.ppm" and "depth".
+std::string outputPath(const std::string &path, const std::string &name);
+
+// Read a PPM image, in either plain ("P3") or raw ("P6") format, from
+// an input stream. Returns nullptr if the stream does not contain a
+// valid image. The caller takes ownership of the returned image.
+DynamicImage *readPPM(std::istream &in);
+
+}  // namespace image
+
 }  // namespace rt
 
 #endif  // RT_IMAGE_H_
@@ -20,6 +20,7 @@
 #ifndef RT_LIGHTS_H_
 #define RT_LIGHTS_H_
 
+#include <algorithm>
 #include <cstdint>
 #include <cstddef>
 #include <vector>
@@ -27,6 +28,7 @@
 #include "rt/graphics.h"
 #include "rt/math.h"
 #include "rt/objects.h"
+#include "rt/profiling.h"
 #include "rt/random.h"
 #include "rt/restrict.h"
 
@@ -39,21 +41,109 @@ class Light {
     virtual ~Light() {}
 
     // Calculate the shading colour at `point' for a given surface
-    // material, surface normal, and direction to the ray.
+    // material, surface normal, and direction to the ray, using at
+    // most `maxSamples' light samples.
     virtual Colour shade(const Vector &point,
                          const Vector &normal,
                          const Vector &toRay,
                          const Material *const restrict material,
-                         const Objects objects) const = 0;
+                         const Objects objects,
+                         const size_t maxSamples) const = 0;
 };
 
 typedef const std::vector<const Light *const> Lights;
 
+// Calculate the shading colour at `point' from a round light source,
+// casting at most `maxSamples' of the light's `samples' shadow rays,
+// with origins offset from the light's centre by `sampler'. The
+// predicate `occluded(ray, distance)' returns whether an object
+// blocks a shadow ray within a given distance.
+template<typename Occluded>
+Colour shadeSoftLight(const Vector &position,
+                      const Colour &colour,
+                      const size_t samples,
+                      UniformDistribution *const restrict sampler,
+                      const Vector &point,
+                      const Vector &normal,
+                      const Vector &toRay,
+                      const Material *const restrict material,
+                      const size_t maxSamples,
+                      const Occluded &occluded) {
+        // Shading is additive, starting with black.
+        Colour output = Colour();
+
+        // Number of light samples to cast.
+        const size_t n = std::min(samples, maxSamples);
+
+        // Product of material and light colour.
+        const Colour illumination = (colour * material->colour) / n;
+
+        // Number of light samples blocked.
+        size_t blocked = 0;
+
+        // Cast multiple light rays, nomrally distributed about the
+        // light's centre.
+        for (size_t i = 0; i < n; i++) {
+                // Create a new point origin randomly offset from centre.
+                const Vector origin = Vector(position.x + (*sampler)(),
+                                             position.y + (*sampler)(),
+                                             position.z + (*sampler)());
+                // Vector from point to light.
+                const Vector toLight = origin - point;
+                // Distance from point to light.
+                const Scalar distance = toLight.size();
+                // Direction from point to light.
+                const Vector direction = toLight / distance;
+
+                // Determine whether light is blocked.
+                profiling::counters::incShadowRayCount();
+                const profiling::Counter tests =
+                                profiling::instrumentation >= 2 ?
+                                profiling::counters::
+                                getThreadIntersectionCount() : 0;
+                const bool isBlocked = occluded(Ray(point, direction),
+                                                distance);
+                if (profiling::instrumentation >= 2) {
+                        const profiling::Counter tested =
+                                        profiling::counters::
+                                        getThreadIntersectionCount() - tests;
+                        profiling::counters::incShadowIntersectionCount(
+                            tested);
+                        profiling::counters::addShadowTests(tested);
+                }
+                // Do nothing without line of sight.
+                if (isBlocked) {
+                        blocked++;
+                        continue;
+                }
+
+                // Bump the profiling counter.
+                profiling::counters::incRayCount();
+
+                // Apply Lambert (diffuse) shading.
+                const Scalar lambert = std::max(normal ^ direction,
+                                                static_cast<Scalar>(0));
+                output += illumination * material->diffuse * lambert;
+
+                // Apply Blinn-Phong (specular) shading.
+                const Vector bisector = (toRay + direction).normalise();
+                const Scalar phong = pow(std::max(normal ^ bisector,
+                                                  static_cast<Scalar>(0)),
+                                         material->shininess);
+                output += illumination * material->specular * phong;
+        }
+
+        profiling::counters::addLightSampling(n, blocked);
+
+        return output;
+}
+
 // A round light source.
 class SoftLight : public Light {
  public:
         const Vector position;
         const Colour colour;
+        const Scalar radius;
         const size_t samples;
         mutable UniformDistribution sampler;
 
@@ -62,8 +152,9 @@ class SoftLight : public Light {
                          const Colour &_colour = Colour(0xff, 0xff, 0xff),
                          const Scalar _radius = 0,
                          const size_t _samples = 1)
-                : position(_position), colour(_colour), samples(_samples),
-                           sampler(UniformDistribution(-_radius, _radius)) {
+                : position(_position), colour(_colour), radius(_radius),
+                  samples(_samples),
+                  sampler(UniformDistribution(-_radius, _radius)) {
                 // Register lights with profiling counter.
                 profiling::counters::incLightsCount(_samples);
         }
@@ -72,7 +163,8 @@ class SoftLight : public Light {
                              const Vector &normal,
                              const Vector &toRay,
                              const Material *const restrict material,
-                             const Objects objects) const;
+                             const Objects objects,
+                             const size_t maxSamples) const;
 };
 
 }  // namespace rt
@@ -79,8 +79,8 @@ class Vector {
         const Scalar w;
 
         // Contructor: V = (x,y,z,w)
-        inline Vector(const Scalar _x, const Scalar _y, const Scalar _z,
-                      const Scalar _w = 0) : x(_x), y(_y), z(_z), w(_w) {}
+        constexpr Vector(const Scalar _x, const Scalar _y, const Scalar _z,
+                         const Scalar _w = 0) : x(_x), y(_y), z(_z), w(_w) {}
 
         // Addition: A' = A + B
         auto inline operator+(const Vector &b) const {
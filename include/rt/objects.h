@@ -20,6 +20,9 @@
 #ifndef OBJECTS_H_
 #define OBJECTS_H_
 
+#include <array>
+#include <cstdint>
+#include <map>
 #include <vector>
 
 #include "rt/graphics.h"
@@ -41,12 +44,12 @@ class Material {
         const Scalar reflectivity;  // 0 <= reflectivity < 1
 
         // Constructor.
-        inline Material(const Colour &_colour,
-                        const Scalar _ambient,
-                        const Scalar _diffuse,
-                        const Scalar _specular,
-                        const Scalar _shininess,
-                        const Scalar _reflectivity)
+        constexpr Material(const Colour &_colour,
+                           const Scalar _ambient,
+                           const Scalar _diffuse,
+                           const Scalar _specular,
+                           const Scalar _shininess,
+                           const Scalar _reflectivity)
                 : colour(_colour),
                   ambient(_ambient),
                   diffuse(_diffuse),
@@ -55,6 +58,45 @@ class Material {
                   reflectivity(_reflectivity) {}
 };
 
+// An index into a material table.
+typedef uint32_t MaterialIndex;
+
+// A contiguous table of materials, which primitives refer to by
+// index. Adding a material which is identical to one already in the
+// table returns the existing index, so the table holds only distinct
+// materials.
+class Materials {
+ public:
+        Materials();
+
+        // Create a read-only view of an existing array of materials.
+        Materials(const Material *const _data, const size_t _size);
+
+        Materials(Materials &&other);
+        Materials(const Materials &) = delete;
+        Materials &operator=(const Materials &) = delete;
+
+        // Add a material to the table, and return its index.
+        MaterialIndex add(const Material &material);
+
+        inline const Material &operator[](const MaterialIndex i) const {
+                return data[i];
+        }
+
+        auto inline size() const { return count; }
+        auto inline begin() const { return data; }
+        auto inline end() const { return data + count; }
+
+ private:
+        // Material properties, used to find duplicates.
+        typedef std::array<Scalar, 8> Key;
+
+        std::vector<Material> owned;
+        std::map<Key, MaterialIndex> indices;
+        const Material *data;
+        size_t count;
+};
+
 // A physical object that light interacts with.
 class Object {
  public:
@@ -75,8 +117,8 @@ class Object {
         // Return whether ray intersects object, and if so, at what
         // distance (0 if no intersect).
         virtual Scalar intersect(const Ray &ray) const = 0;
-        // Return material at point on surface.
-        virtual const Material *surface(const Vector &point) const = 0;
+        // Return the index of the material at point on surface.
+        virtual MaterialIndex surface(const Vector &point) const = 0;
 };
 
 typedef const std::vector<const Object *const> Objects;
@@ -85,12 +127,12 @@ typedef const std::vector<const Object *const> Objects;
 class Plane : public Object {
  public:
         const Vector direction;
-        const Material *const restrict material;
+        const MaterialIndex material;
 
         // Constructor.
         inline Plane(const Vector &_origin,
                      const Vector &_direction,
-                     const Material *const restrict _material)
+                     const MaterialIndex _material)
                 : Object(_origin),
                   direction(_direction.normalise()),
                   material(_material) {}
@@ -117,29 +159,36 @@ class Plane : public Object {
                         return 0;
         }
 
-        virtual inline const Material *surface(const Vector &point) const {
+        virtual inline MaterialIndex surface(const Vector &point) const {
                 return material;
         }
+
+ private:
+#pragma GCC diagnostic push  // Ignore unused "_pad" variable.
+#pragma GCC diagnostic ignored "-Wunused-private-field"
+        // Padding bytes since the material index is only four bytes.
+        char _pad[4];
+#pragma GCC diagnostic pop  // Ignore unused "_pad" variable.
 };
 
 class CheckerBoard : public Plane {
 public:
-        const Material *const restrict material1;
-        const Material *const restrict material2;
         const Scalar checkerWidth;
+        const MaterialIndex material1;
+        const MaterialIndex material2;
 
         inline CheckerBoard(const Vector &_origin,
                             const Vector &_direction,
                             const Scalar _checkerWidth,
-                            const Material *const restrict _material1,
-                            const Material *const restrict _material2)
-                : Plane(_origin, _direction, nullptr),
-                        material1(_material1), material2(_material2),
-                        checkerWidth(_checkerWidth) {}
+                            const MaterialIndex _material1,
+                            const MaterialIndex _material2)
+                : Plane(_origin, _direction, _material1),
+                        checkerWidth(_checkerWidth),
+                        material1(_material1), material2(_material2) {}
 
         inline ~CheckerBoard() {}
 
-        virtual inline const Material *surface(const Vector &point) const {
+        virtual inline MaterialIndex surface(const Vector &point) const {
                 // TODO: translate point to a relative position on plane.
                 const Vector relative = Vector(point.x + gridOffset,
                                                point.z + gridOffset, 0);
@@ -163,12 +212,12 @@ private:
 class Sphere : public Object {
 public:
         const Scalar radius;
-        const Material *const restrict material;
+        const MaterialIndex material;
 
         // Constructor.
         inline Sphere(const Vector &_position,
                       const Scalar _radius,
-                      const Material *const restrict _material)
+                      const MaterialIndex _material)
                 : Object(_position), radius(_radius), material(_material) {}
 
         virtual inline Vector normal(const Vector &p) const {
@@ -195,9 +244,16 @@ public:
                         return 0;
         }
 
-        virtual inline const Material *surface(const Vector &point) const {
+        virtual inline MaterialIndex surface(const Vector &point) const {
                 return material;
         }
+
+ private:
+#pragma GCC diagnostic push  // Ignore unused "_pad" variable.
+#pragma GCC diagnostic ignored "-Wunused-private-field"
+        // Padding bytes since the material index is only four bytes.
+        char _pad[4];
+#pragma GCC diagnostic pop  // Ignore unused "_pad" variable.
 };
 
 }  // namespace rt
@@ -0,0 +1,40 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RT_OPTIONS_H_
+#define RT_OPTIONS_H_
+
+#include <cstdint>
+
+namespace rt {
+
+// Command line option parsing, shared by the tools and benchmarks.
+namespace options {
+
+// Parse a positive decimal integer option value, or a non-negative
+// one if "allowZero" is set. Prints an error naming "option" and
+// exits if the value is invalid.
+uint64_t count(const char *const option, const char *const value,
+               const bool allowZero = false);
+
+}  // namespace options
+
+}  // namespace rt
+
+#endif  // RT_OPTIONS_H_
@@ -0,0 +1,81 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RT_PERF_H_
+#define RT_PERF_H_
+
+#include <cstdint>
+#include <string>
+
+namespace rt {
+
+namespace profiling {
+
+// Counts of hardware events.
+class HardwareCounts {
+ public:
+        uint64_t cycles = 0;
+        uint64_t instructions = 0;
+        uint64_t cacheMisses = 0;
+        uint64_t branchMisses = 0;
+
+        HardwareCounts &operator+=(const HardwareCounts &other);
+        HardwareCounts operator-(const HardwareCounts &other) const;
+
+        // Return the instructions per cycle, or zero if unknown.
+        double ipc() const;
+};
+
+// The hardware performance counters of the calling thread, and of
+// threads it creates after the counters are opened, read using the
+// Linux perf_event_open() interface. Open the counters before the
+// first parallel render, so that they follow the worker threads.
+class HardwareCounters {
+ public:
+        // Open the counters. If no counter can be opened, for example
+        // on other platforms, or where the kernel does not permit
+        // it, the counters are unavailable and error() says why.
+        HardwareCounters();
+        ~HardwareCounters();
+
+        HardwareCounters(const HardwareCounters &) = delete;
+        HardwareCounters &operator=(const HardwareCounters &) = delete;
+
+        inline bool available() const { return opened > 0; }
+        inline const std::string &error() const { return reason; }
+
+        // Return the counts since the counters were opened. Events
+        // which could not be opened read as zero. Counts are scaled
+        // up if the kernel multiplexed the counters.
+        HardwareCounts read() const;
+
+ private:
+        static constexpr size_t numEvents = 4;
+
+        int fds[numEvents];
+        // The number of counters opened.
+        size_t opened;
+        std::string reason;
+};
+
+}  // namespace profiling
+
+}  // namespace rt
+
+#endif  // RT_PERF_H_
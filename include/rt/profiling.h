@@ -20,15 +20,41 @@
 #ifndef RT_PROFILING_H_
 #define RT_PROFILING_H_
 
+#include <array>
 #include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "tbb/cache_aligned_allocator.h"
+#include "tbb/enumerable_thread_specific.h"
 
 #include "rt/math.h"
+#include "rt/perf.h"
+
+// The level of instrumentation compiled in:
+//
+//   0  None. Counters and thread busy time compile to nothing, and
+//      read as zero.
+//   1  Count the work done by renders (the default).
+//   2  Full. Also count reflections, the intersection tests made by
+//      shadow rays, and the chunks visited by rays in out-of-core
+//      renders, and collect histograms of the work per ray, shading
+//      point, and pixel.
+#ifndef RT_INSTRUMENTATION
+# define RT_INSTRUMENTATION 1
+#endif
 
 namespace rt {
 
 namespace profiling {
 
+class Timeline;
+
+// The level of instrumentation compiled in. See RT_INSTRUMENTATION.
+static constexpr int instrumentation = RT_INSTRUMENTATION;
+
 // A profiling timer.
 class Timer {
  public:
@@ -51,8 +77,255 @@ class Timer {
 // Counter data type.
 typedef uint64_t Counter;
 
+// A histogram of non-negative integers, in power of two buckets.
+// Bucket 0 counts zeros, and bucket i counts values in [2^(i-1),
+// 2^i). The last bucket also counts all larger values.
+class Histogram {
+ public:
+        static constexpr size_t size = 24;
+
+        std::array<Counter, size> buckets = {};
+        // The number of values, their sum, and the largest.
+        Counter count = 0;
+        Counter sum = 0;
+        Counter max = 0;
+
+        inline void add(const Counter value) {
+                const size_t bucket = value ? static_cast<size_t>(
+                    64 - __builtin_clzll(value)) : 0;
+                buckets[bucket < size ? bucket : size - 1]++;
+                count++;
+                sum += value;
+                if (value > max)
+                        max = value;
+        }
+
+        // Return the smallest value counted by a bucket.
+        static inline Counter lower(const size_t bucket) {
+                return bucket ? Counter(1) << (bucket - 1) : 0;
+        }
+
+        // Return the mean value, or zero if empty.
+        inline Scalar mean() const {
+                return count ? static_cast<Scalar>(sum) / count : 0;
+        }
+
+        // Zero the histogram in place.
+        void clear();
+
+        Histogram &operator+=(const Histogram &other);
+};
+
+// The work done by a render.
+class Counts {
+ public:
+        Counter traces = 0;
+        Counter rays = 0;
+        Counter shadowRays = 0;
+        Counter intersections = 0;
+        // Only counted with full instrumentation:
+        Counter reflections = 0;
+        Counter shadowIntersections = 0;
+        Counter chunkVisits = 0;
+        // The number of times a light was sampled from a shading
+        // point, by whether none, some, or all of the shadow rays
+        // cast were blocked.
+        Counter lit = 0;
+        Counter penumbra = 0;
+        Counter umbra = 0;
+        // The reflection depth reached by each primary ray, the
+        // intersection tests made by each traced ray and shadow ray,
+        // the shadow rays cast from each shading point, and the
+        // supersampling recursion depth of each pixel.
+        Histogram reflectionDepth;
+        Histogram traceTests;
+        Histogram shadowTests;
+        Histogram shadowRaysPerPoint;
+        Histogram supersampleDepth;
+        // Nanoseconds spent by threads in parallel work. Counted at
+        // every level of instrumentation.
+        Counter busy = 0;
+
+        // Zero all counts in place. Counts are large with their
+        // histograms, so this avoids building a temporary.
+        void clear();
+
+        Counts &operator+=(const Counts &other);
+};
+
+// The statistics of a render, sharded by thread. Each thread counts
+// into its own cache-aligned shard, so counting does not contend, and
+// the shards are merged when read. Shards must not be read or reset
+// while a render is counting into them.
+class Statistics {
+ public:
+        // Return the sum of all threads' counts.
+        Counts totals() const;
+
+        // Return the sum of a single count of all threads, without
+        // merging the rest.
+        Counter total(Counter Counts::*const count) const;
+
+        // Return the nanoseconds spent by all threads in parallel
+        // work.
+        inline Counter busy() const { return total(&Counts::busy); }
+
+        // Zero all counts.
+        void reset();
+
+        // Return the calling thread's shard.
+        inline Counts &local() { return shards.local(); }
+
+ private:
+        tbb::enumerable_thread_specific<
+                Counts,
+                tbb::cache_aligned_allocator<Counts>,
+                tbb::ets_key_per_instance> shards;
+};
+
+#if RT_INSTRUMENTATION >= 1
+
+// Direct the calling thread's counters into a Statistics object for
+// the lifetime of the scope. Outside of any scope, a thread counts
+// into a private shard which is never merged.
+class Scope {
+ public:
+        explicit Scope(Statistics *const statistics);
+        ~Scope();
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+ private:
+        Counts *const previous;
+};
+
+// Add the time for which it is in scope to the busy time of the
+// calling thread's current Scope. Used to measure the utilisation of
+// threads in parallel passes.
+class BusyTimer {
+ public:
+        inline BusyTimer() : start(std::chrono::steady_clock::now()) {}
+        ~BusyTimer();
+
+ private:
+        const std::chrono::steady_clock::time_point start;
+};
+
+#else  // RT_INSTRUMENTATION < 1
+
+class Scope {
+ public:
+        explicit inline Scope(Statistics *const statistics) {}
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+};
+
+class BusyTimer {
+ public:
+        inline BusyTimer() {}
+};
+
+#endif  // RT_INSTRUMENTATION >= 1
+
+// A tree of the named phases of a run, and the time spent in each,
+// recorded by Phase timers.
+class Phases {
+ public:
+        class Node {
+         public:
+                std::string name;
+                // Index of the enclosing phase, or "none" for a root.
+                size_t parent;
+                // The number of times the phase was entered, and the
+                // total wall-clock time spent in it.
+                size_t calls;
+                Scalar seconds;
+                // For parallel phases, the time spent working by all
+                // threads, and the number of threads available.
+                // Otherwise zero.
+                Scalar busy;
+                size_t threads;
+                // Hardware events counted during the phase, if the
+                // recording has hardware counters.
+                HardwareCounts hardware;
+
+                // Return the fraction of the available thread time
+                // spent working, or zero if not a parallel phase.
+                Scalar utilisation() const;
+        };
+
+        static constexpr size_t none = static_cast<size_t>(-1);
+
+        // If set, and available, phases also count hardware events.
+        const HardwareCounters *hardware = nullptr;
+
+        inline const std::vector<Node> &nodes() const { return tree; }
+
+        // Return the indices of the children of a node, or of the
+        // roots if "none", in the order they were first entered.
+        std::vector<size_t> children(const size_t node) const;
+
+        // Return the calling thread's recording, if any.
+        static Phases *current();
+
+ private:
+        friend class Phase;
+
+        std::vector<Node> tree;
+        // The innermost phase being timed.
+        size_t open = none;
+};
+
+// Record the phases entered by the calling thread into a tree for the
+// lifetime of the scope.
+class Recording {
+ public:
+        explicit Recording(Phases *const phases);
+        ~Recording();
+
+        Recording(const Recording &) = delete;
+        Recording &operator=(const Recording &) = delete;
+
+ private:
+        Phases *const previous;
+};
+
+// Time a named phase, nested within the calling thread's innermost
+// phase. Repeated phases of the same name are accumulated. If
+// "statistics" is provided, the phase is a parallel pass, whose
+// threads count their busy time into it, if instrumented. Does
+// nothing if the calling thread is not recording. Phases are also
+// recorded as spans on the active timeline, if any.
+class Phase {
+ public:
+        explicit Phase(const char *const name,
+                       const Statistics *const statistics = nullptr);
+        ~Phase();
+
+        Phase(const Phase &) = delete;
+        Phase &operator=(const Phase &) = delete;
+
+        // End the phase before the end of the scope.
+        void end();
+
+ private:
+        Phases *phases;
+        Timeline *const timeline;
+        const Statistics *const statistics;
+        // The name of the phase, or nullptr once ended.
+        const char *name;
+        size_t node;
+        Counter busy;
+        HardwareCounts hardware;
+        const std::chrono::steady_clock::time_point start;
+};
+
 namespace counters {
 
+#if RT_INSTRUMENTATION >= 1
+
 // Counter for the number of objects.
 void incObjectsCount(const size_t n = 1);
 Counter getObjectsCount();
@@ -61,13 +334,66 @@ Counter getObjectsCount();
 void incLightsCount(const size_t n = 1);
 Counter getLightsCount();
 
-// Counter for the number of traces.
+// Counters for the work done by a render, which count into the
+// calling thread's current Scope. The getters return the calling
+// thread's counts, and are used to attribute rendering cost to
+// pixels. Use Statistics::totals() for the totals of a render.
 void incTraceCount(const size_t n = 1);
-Counter getTraceCount();
-
-// Counter for the number of rays.
+Counter getThreadTraceCount();
 void incRayCount(const size_t n = 1);
-Counter getRayCount();
+Counter getThreadRayCount();
+void incShadowRayCount(const size_t n = 1);
+Counter getThreadShadowRayCount();
+void incIntersectionCount(const size_t n = 1);
+Counter getThreadIntersectionCount();
+
+#else  // RT_INSTRUMENTATION < 1
+
+inline void incObjectsCount(const size_t n = 1) {}
+inline Counter getObjectsCount() { return 0; }
+inline void incLightsCount(const size_t n = 1) {}
+inline Counter getLightsCount() { return 0; }
+inline void incTraceCount(const size_t n = 1) {}
+inline Counter getThreadTraceCount() { return 0; }
+inline void incRayCount(const size_t n = 1) {}
+inline Counter getThreadRayCount() { return 0; }
+inline void incShadowRayCount(const size_t n = 1) {}
+inline Counter getThreadShadowRayCount() { return 0; }
+inline void incIntersectionCount(const size_t n = 1) {}
+inline Counter getThreadIntersectionCount() { return 0; }
+
+#endif  // RT_INSTRUMENTATION >= 1
+
+#if RT_INSTRUMENTATION >= 2
+
+// Counters for full instrumentation.
+void incReflectionCount(const size_t n = 1);
+void incShadowIntersectionCount(const size_t n = 1);
+void incChunkVisitCount(const size_t n = 1);
+
+// Histograms for full instrumentation. See Counts.
+void addReflectionDepth(const size_t depth);
+void addTraceTests(const Counter tests);
+void addShadowTests(const Counter tests);
+void addShadowRaysPerPoint(const Counter rays);
+void addSupersampleDepth(const size_t depth);
+// Record the sampling of a light from a shading point, casting
+// "samples" shadow rays, of which "blocked" were blocked.
+void addLightSampling(const size_t samples, const size_t blocked);
+
+#else  // RT_INSTRUMENTATION < 2
+
+inline void incReflectionCount(const size_t n = 1) {}
+inline void incShadowIntersectionCount(const size_t n = 1) {}
+inline void incChunkVisitCount(const size_t n = 1) {}
+inline void addReflectionDepth(const size_t depth) {}
+inline void addTraceTests(const Counter tests) {}
+inline void addShadowTests(const Counter tests) {}
+inline void addShadowRaysPerPoint(const Counter rays) {}
+inline void addSupersampleDepth(const size_t depth) {}
+inline void addLightSampling(const size_t samples, const size_t blocked) {}
+
+#endif  // RT_INSTRUMENTATION >= 2
 
 }  // namespace counters
 
@@ -0,0 +1,181 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RT_PROGRESS_H_
+#define RT_PROGRESS_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+#include "rt/math.h"
+#include "rt/profiling.h"
+
+namespace rt {
+
+namespace profiling {
+
+// Live progress of a render, written periodically by a background
+// thread while monitoring, as one JSON object per line:
+//
+//   {"progress": {"pass": "primary", "passIndex": 1, "passes": 3,
+//                 "percent": 45.8, "tiles": 96, "raysPerSecond": ...,
+//                 "elapsedSeconds": ..., "passRemainingSeconds": ...,
+//                 "threadBusySeconds": [...], "done": false}}
+//
+// A run divides its work into passes, such as a preview followed by
+// the primary and supersampling passes of a render, reported with
+// begin() and finish(). Threads report the work they complete using
+// Work: the tiles of parallel passes, or the pixels of serial passes.
+// The percentage counts the passes of the run equally, so it never
+// decreases, but is not proportional to time. The remaining time
+// extrapolates the current pass only, from its rate so far. There is
+// no estimate for the whole run, since the cost of a supersampling
+// pass depends on how many pixels need supersampling, which is not
+// known until it runs. A line is written at the end of each pass,
+// with "done" set after the last.
+class Progress {
+ public:
+        typedef std::chrono::steady_clock::time_point Time;
+
+        // Write progress to "out" every "interval" seconds.
+        explicit Progress(const Scalar interval = 1, FILE *const out = stderr);
+        ~Progress();
+
+        Progress(const Progress &) = delete;
+        Progress &operator=(const Progress &) = delete;
+
+        // Begin pass "index" of "passes" of the active monitor's
+        // render, named "name" and made up of "units" units of work.
+        // The name must outlive the monitor. Does nothing if there is
+        // no active monitor.
+        static void begin(const char *const _name,
+                          const size_t _units,
+                          const size_t _index,
+                          const size_t _passes);
+
+        // Write the progress of the active monitor at the end of its
+        // current pass, if any.
+        static void finish();
+
+        // Record "units" units of work completed by the calling
+        // thread in "nanoseconds", casting "rays" rays.
+        void advance(const size_t _units,
+                     const Counter nanoseconds,
+                     const Counter rays);
+
+        // Return the active monitor, if any.
+        static Progress *active();
+
+ private:
+        friend class Monitoring;
+
+        // The work of a thread, padded to a cache line.
+        class Slot {
+         public:
+                std::atomic<Counter> busy;
+                std::atomic<Counter> rays;
+         private:
+#pragma GCC diagnostic push  // Ignore unused "_pad" variable.
+#pragma GCC diagnostic ignored "-Wunused-private-field"
+                char _pad[48];
+#pragma GCC diagnostic pop  // Ignore unused "_pad" variable.
+        };
+
+        // Start and stop the reporting thread.
+        void start();
+        void stop();
+
+        // Write a line of progress, at the end of the current pass if
+        // "passDone" is set. Called with "mutex" held.
+        void report(const bool passDone);
+
+        const std::chrono::duration<Scalar> interval;
+        FILE *const out;
+        const size_t numSlots;
+        Slot *const slots;
+
+        // Work completed in the current pass, and in total.
+        std::atomic<size_t> units;
+        std::atomic<size_t> tiles;
+
+        // The current pass, guarded by "mutex". No pass is reported
+        // if "name" is nullptr.
+        std::mutex mutex;
+        std::condition_variable wake;
+        const char *name;
+        size_t total;
+        size_t index;
+        size_t passes;
+        Time epoch;
+        Time passStart;
+        // The time and rays of the last report, for the ray rate.
+        Time lastReport;
+        Counter lastRays;
+        bool stopping;
+#pragma GCC diagnostic push  // Ignore unused "_pad" variable.
+#pragma GCC diagnostic ignored "-Wunused-private-field"
+        // Padding bytes since the flag is only one byte.
+        char _pad[7];
+#pragma GCC diagnostic pop  // Ignore unused "_pad" variable.
+        std::thread thread;
+};
+
+// Make a progress monitor the active monitor of all threads, and
+// report its progress, for the lifetime of the scope. Does nothing if
+// "progress" is nullptr.
+class Monitoring {
+ public:
+        explicit Monitoring(Progress *const progress);
+        ~Monitoring();
+
+        Monitoring(const Monitoring &) = delete;
+        Monitoring &operator=(const Monitoring &) = delete;
+
+ private:
+        Progress *const progress;
+        Progress *const previous;
+};
+
+// Record "units" units of work done by the calling thread in the
+// scope to the active progress monitor, if any, along with the time
+// taken and the rays cast.
+class Work {
+ public:
+        explicit Work(const size_t units);
+        ~Work();
+
+        Work(const Work &) = delete;
+        Work &operator=(const Work &) = delete;
+
+ private:
+        Progress *const progress;
+        const size_t units;
+        Counter rays;
+        Progress::Time start;
+};
+
+}  // namespace profiling
+
+}  // namespace rt
+
+#endif  // RT_PROGRESS_H_
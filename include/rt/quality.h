@@ -0,0 +1,77 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RT_QUALITY_H_
+#define RT_QUALITY_H_
+
+#include "rt/image.h"
+#include "rt/math.h"
+
+namespace rt {
+
+/*
+ * Objective image quality metrics. These compare a test image against
+ * a reference image of the same dimensions, so that the loss in
+ * quality caused by a cheaper set of render settings can be measured.
+ */
+namespace quality {
+
+// The result of comparing two images.
+class Comparison {
+ public:
+        // Mean squared error of R,G,B components, in the range [0,1].
+        Scalar mse;
+        // Peak signal to noise ratio, in decibels. Infinite if the
+        // images are identical.
+        Scalar psnr;
+        // Mean structural similarity index, in the range [-1,1]. A
+        // value of 1 means the images are identical.
+        Scalar ssim;
+        // The largest absolute R,G,B component error, in the range
+        // [0,1].
+        Scalar maxError;
+};
+
+// Return the mean squared error between two images.
+Scalar mse(const DynamicImage &reference, const DynamicImage &image);
+
+// Return the peak signal to noise ratio between two images.
+Scalar psnr(const DynamicImage &reference, const DynamicImage &image);
+
+// Return the mean structural similarity index between the luminance
+// of two images, using an 11x11 gaussian window.
+Scalar ssim(const DynamicImage &reference, const DynamicImage &image);
+
+// Compute all metrics between two images.
+Comparison compare(const DynamicImage &reference, const DynamicImage &image);
+
+// Write a per-pixel heatmap of the absolute difference between two
+// images to "out", which must have the same dimensions. Errors are
+// multiplied by "scale" before being mapped to colours, so that small
+// differences are visible.
+void errorMap(const DynamicImage &reference,
+              const DynamicImage &image,
+              DynamicImage *const out,
+              const Scalar scale = 4);
+
+}  // namespace quality
+
+}  // namespace rt
+
+#endif  // RT_QUALITY_H_
@@ -67,9 +67,11 @@ class UniformDiskDistribution {
  public:
         inline UniformDiskDistribution(const Scalar _radius,
                                        const Seed _seed = 7564231ULL)
-                : angle(UniformDistribution(0, 2 * M_PI, _seed)),
-                  rand01(UniformDistribution(0, 1, _seed)),
-                  radius(_radius) {}
+                : radius(_radius),
+                  angle(UniformDistribution(0, 2 * M_PI, _seed)),
+                  rand01(UniformDistribution(0, 1, _seed)) {}
+
+        const Scalar radius;
 
         // Return a random point on the disk, with the vector x and y
         // components corresponding to the x and y coordinates of the
@@ -87,7 +89,6 @@ class UniformDiskDistribution {
  private:
         UniformDistribution angle;
         UniformDistribution rand01;
-        const Scalar radius;
 };
 
 }  // namespace rt
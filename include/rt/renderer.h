@@ -20,33 +20,76 @@
 #ifndef RT_RENDERER_H_
 #define RT_RENDERER_H_
 
+#include <algorithm>
 #include <array>
-#include <vector>
 #include <cstdint>
+#include <limits>
 
+#include "tbb/blocked_range.h"
 #include "tbb/parallel_for.h"
 
+#include "rt/aov.h"
+#include "rt/buffers.h"
 #include "rt/camera.h"
+#include "rt/denoise.h"
 #include "rt/image.h"
+#include "rt/profiling.h"
+#include "rt/progress.h"
 #include "rt/random.h"
 #include "rt/ray.h"
 #include "rt/scene.h"
+#include "rt/timeline.h"
 
 namespace rt {
 
+// Intermediate storage for Renderer::render(). Buffers are resized on
+// demand and reused, so repeated renders of the same image size do not
+// allocate memory.
+class RenderBuffers {
+ public:
+        inline RenderBuffers() : guides(Denoiser::requiredOutputs) {}
+
+        // A single sample for every pixel in the image, plus a border
+        // of 1 pixel on all sides.
+        Buffer<Sample> sampled;
+        // The supersampled image.
+        Buffer<Sample> superSampled;
+        // Scratch space for denoising.
+        Buffer<Sample> filtered;
+        // Denoiser guide outputs, used if the caller's auxiliary
+        // outputs do not provide them.
+        AuxiliaryBuffers guides;
+        // The sample variance of each pixel of the last preview, and
+        // its dimensions. Consumed by the next render, and zero sized
+        // if there is no preview.
+        Buffer<float> previewVariance;
+        size_t previewWidth = 0;
+        size_t previewHeight = 0;
+        // The work done by the last render or preview.
+        profiling::Statistics statistics;
+};
+
 class Renderer {
         // Anti-aliasing tunable knobs.
         static constexpr Scalar maxPixelDiff     = 0.0000005;
         static constexpr Scalar maxSubpixelDiff  = 0.008;
         static constexpr size_t maxSubpixelDepth = 3;
 
+        // Preview tunable knobs. At least two lens samples are
+        // required to estimate variance.
+        static constexpr size_t previewDofSamples   = 2;
+        static constexpr size_t previewLightSamples = 1;
+        static constexpr size_t previewRayDepth     = 1;
+        static constexpr Scalar maxPreviewVariance  = 0.0001;
+
  public:
         Renderer(const Scene &scene,
                  const rt::Camera *const restrict camera,
                  const size_t numDofSamples = 1,
-                 const size_t maxRayDepth   = 5000);
+                 const size_t maxRayDepth   = 5000,
+                 const Denoiser *const denoiser = nullptr);
 
-        ~Renderer();
+        virtual ~Renderer();
 
         const Scene &scene;
         const rt::Camera *const restrict camera;
@@ -61,27 +104,145 @@ class Renderer {
         // Number of samples to make for depth of field:
         const size_t numDofSamples;
 
-        // The heart of the raytracing engine.
+        // Optional denoising stage, applied to the supersampled image:
+        const Denoiser *const denoiser;
+
+        // The number of passes reported to the active progress
+        // monitor by render() and preview().
+        static constexpr size_t renderPasses  = 2;
+        static constexpr size_t previewPasses = 1;
+
+        // The heart of the raytracing engine. If "aux" is provided,
+        // its enabled auxiliary outputs are filled during the
+        // render. Intermediate results are stored in "buffers" if
+        // provided, else in buffers owned by the renderer. Concurrent
+        // renders using the same renderer must each provide their own
+        // buffers. Progress is reported as passes "pass" onwards of
+        // "passes", so that a run of several renders is reported as
+        // one.
         template<typename Image>
-        void render(Image *const image) const;
+        void render(Image *const image,
+                    AuxiliaryBuffers *const aux = nullptr,
+                    RenderBuffers *const buffers = nullptr,
+                    const size_t pass = 0,
+                    const size_t passes = renderPasses) const;
+
+        // Render a fast preview of the scene, without supersampling,
+        // and with reduced lens samples, light samples, and ray
+        // depth. The preview is typically a fraction of the
+        // resolution of the final image. If "guide" is set, the
+        // sample variance of each preview pixel is stored in
+        // "buffers" (or the renderer's own buffers), and used by the
+        // next render to take a single lens and light sample for
+        // pixels which are free of sampling noise, trading some
+        // quality for speed. Pixels whose first hit is reflective are
+        // never reduced. Otherwise, the next render is unaffected.
+        // Progress is reported as in render().
+        template<typename Image>
+        void preview(Image *const image,
+                     RenderBuffers *const buffers = nullptr,
+                     const bool guide = false,
+                     const size_t pass = 0,
+                     const size_t passes = previewPasses) const;
+
+        // Render a single pixel of an image at full quality, sampling
+        // its neighbours as render() does to decide whether to
+        // supersample it, and return the number of points sampled
+        // for the pixel. If "cost" is provided, it is set once the
+        // neighbours have been sampled, so that the caller can
+        // measure the cost of the pixel alone. The result is
+        // discarded: this is for cost estimation.
+        size_t samplePixel(const size_t x,
+                           const size_t y,
+                           const size_t width,
+                           const size_t height,
+                           Cost *const cost = nullptr) const;
+
+        // Return the work done by the last render or preview which
+        // used the renderer's own buffers.
+        inline const profiling::Statistics &statistics() const {
+                return buffers.statistics;
+        }
+
+ protected:
+        // The sampling settings for a ray.
+        class Quality {
+         public:
+                size_t dofSamples;
+                size_t lightSamples;
+                size_t rayDepth;
+        };
+
+        // Trace a ray trough a given scene and return the final
+        // colour. If "hit" is provided, record the first surface
+        // hit. Renderers for specialised scene representations
+        // override this.
+        virtual Colour trace(const Ray &ray,
+                             const Quality &quality,
+                             const unsigned int depth = 0,
+                             Hit *const restrict hit = nullptr) const;
+
+        // The implementation of trace() for a scene representation
+        // "view", which provides:
+        //
+        //   typedef ... Primitive;
+        //   bool intersect(ray, &t, &index, &primitive);
+        //   Vector normal(primitive, point);
+        //   MaterialIndex surface(primitive, point);
+        //   const Material &material(index);
+        //   void shade(&colour, point, normal, toRay, material, samples);
+        //
+        // Where intersect() finds the closest intersection, and
+        // shade() adds the shading from each light source.
+        template<typename View>
+        Colour traceScene(const View &view,
+                          const Ray &ray,
+                          const Quality &quality,
+                          const unsigned int depth,
+                          Hit *const restrict hit) const;
 
  private:
-        // Recursively supersample a region.
+        // Reusable intermediate storage.
+        mutable RenderBuffers buffers;
+
+        // Return the image to camera transformation matrix for an
+        // image size.
+        Matrix transform(const size_t width, const size_t height) const;
+
+        // Return whether the preview stored in "storage" found the
+        // neighbourhood of an image pixel to be free of sampling
+        // noise.
+        bool noiseless(const RenderBuffers &storage,
+                       const size_t x,
+                       const size_t y,
+                       const size_t width,
+                       const size_t height) const;
+
+        // Return whether the surface of a hit is reflective.
+        bool reflective(const Hit &hit) const;
+
+        // Recursively supersample a region, adding the number of
+        // points sampled to "samples", and raising "reached" to the
+        // deepest level of recursion.
         Colour renderRegion(const Scalar x,
                             const Scalar y,
                             const Scalar regionSize,
                             const Matrix &transform,
+                            const Quality &quality,
+                            size_t *const restrict samples,
+                            size_t *const restrict reached,
                             const size_t depth = 0) const;
 
-        // Get the colour value at a single point.
+        // Get the colour value at a single point. If "hit" is
+        // provided, record the first surface hit by the ray through
+        // the point. If "variance" is provided, set it to the sample
+        // variance of the lens samples.
         Colour renderPoint(const Scalar x,
                            const Scalar y,
-                           const Matrix &transform) const;
-
-        // Trace a ray trough a given scene and return the final
-        // colour.
-        Colour trace(const Ray &ray,
-                     const unsigned int depth = 0) const;
+                           const Matrix &transform,
+                           const Quality &quality,
+                           Hit *const restrict hit = nullptr,
+                           float *const restrict variance = nullptr) const;
 
         // Perform supersample interpolation.
         Colour interpolate(const size_t image_x,
@@ -91,90 +252,337 @@ class Renderer {
 };
 
 template<typename Image>
-void Renderer::render(Image *const image) const {
+void Renderer::render(Image *const image,
+                      AuxiliaryBuffers *const aux,
+                      RenderBuffers *const _buffers,
+                      const size_t pass,
+                      const size_t passes) const {
+        RenderBuffers *const restrict storage =
+                        _buffers ? _buffers : &buffers;
+
+        // Count the work done by this render.
+        storage->statistics.reset();
+        const profiling::Scope scope(&storage->statistics);
+
         // Create image to camera transformation matrix.
-        //
-        // Create a transformation matrix to scale from image
-        // space coordinates (i.e. [x,y] coordinates with
-        // reference to the image size) to camera space
-        // coordinates (i.e. [x,y] coordinates with reference
-        // to the camera's film size).
-        //
-        // Scale image coordinates to camera coordinates.
-        const Scale scale(camera->width / image->width,
-                          camera->height / image->height, 1);
-        // Offset from image coordinates to camera coordinates.
-        const Translation offset(-(image->width * .5),
-                                 -(image->height * .5), 0);
-        const auto transformMatrix = scale * offset;
+        const Matrix transformMatrix = transform(image->width,
+                                                 image->height);
+
+        // Sampling settings. If there is a preview, pixels which it
+        // found to be free of sampling noise take a single lens and
+        // light sample.
+        const Quality full = {numDofSamples,
+                              std::numeric_limits<size_t>::max(),
+                              maxRayDepth};
+        const Quality reduced = {1, 1, maxRayDepth};
+        const auto quality = [&](const size_t x, const size_t y)
+                        -> const Quality & {
+                return noiseless(*storage, x, y, image->width,
+                                 image->height) ? reduced : full;
+        };
 
         // First, we collect a single sample for every pixel in the
         // image, plus an additional border of 1 pixel on all sides.
         const size_t borderedWidth = image->width + 2;
         const size_t borderedHeight = image->height + 2;
         const size_t borderedSize = borderedWidth * borderedHeight;
-        std::vector<Colour> sampled(borderedSize);
+        Buffer<Sample> &sampled = storage->sampled;
+        sampled.resize(borderedSize);
+
+        // Prepare auxiliary outputs, if required. The denoiser uses
+        // the caller's outputs as guides if they are sufficient, else
+        // our own.
+        if (aux)
+                aux->resize(image->size);
+        AuxiliaryBuffers *const guides = denoiser ?
+                        (aux && aux->provides(Denoiser::requiredOutputs) ?
+                         aux : &storage->guides) : nullptr;
+        if (guides && guides != aux)
+                guides->resize(image->size);
+
+        // Collect a sample for a bordered pixel:
+        const auto collect = [&](const size_t index) {
+                // Get the pixel coordinates.
+                const auto x = image::x(index, borderedWidth);
+                const auto y = image::y(index, borderedWidth);
+                // Sampling settings of the nearest image pixel.
+                const Quality &q = quality(
+                    std::min(x ? x - 1 : 0, image->width - 1),
+                    std::min(y ? y - 1 : 0, image->height - 1));
+
+                // Pixels outside of the border record auxiliary
+                // outputs, if required.
+                if ((aux || guides) && x > 0 && x <= image->width &&
+                    y > 0 && y <= image->height) {
+                        const size_t pixel = image::index(x - 1, y - 1,
+                                                          image->width);
+                        const Cost start;
+                        Hit hit;
+
+                        sampled[index] = Sample(renderPoint(
+                            x - .5, y - .5, transformMatrix, q, &hit));
+
+                        if (guides && guides != aux)
+                                guides->record(pixel, hit);
+                        if (!aux)
+                                return;
+
+                        aux->record(pixel, hit);
+                        aux->addCost(pixel, start);
+                        return;
+                }
+
+                // Sample a point in the centre of the pixel. The
+                // bordered pixel (x, y) is image pixel (x - 1, y - 1).
+                sampled[index] = Sample(renderPoint(x - .5, y - .5,
+                                                    transformMatrix, q));
+        };
 
         // Collect pixel samples:
+        profiling::Phase primary("primary", &storage->statistics);
+        profiling::Progress::begin("primary", sampled.size(), pass, passes);
         tbb::parallel_for(
-            static_cast<size_t>(0),
-            sampled.size(),
-            [&](const size_t index) {
-                    // Get the pixel coordinates.
-                    const auto x = image::x(index, borderedWidth);
-                    const auto y = image::y(index, borderedWidth);
-
-                    // Sample a point in the centre of the pixel.
-                    sampled[index] = renderPoint(x + .5, y + .5,
-                                                 transformMatrix);
+            tbb::blocked_range<size_t>(0, sampled.size()),
+            [&](const tbb::blocked_range<size_t> &range) {
+                    const profiling::Scope rangeScope(&storage->statistics);
+                    const profiling::BusyTimer busy;
+                    const profiling::Span span("tile", range.begin(),
+                                               range.size());
+                    const profiling::Work work(range.size());
+
+                    for (size_t index = range.begin();
+                         index != range.end(); index++)
+                            collect(index);
             });
+        primary.end();
 
-        // Allocate memory for super-sampled image.
-        std::vector<Colour> superSampled(image->size);
+        // Super-sampled image.
+        profiling::Phase supersample("supersample");
+        profiling::Progress::finish();
+        profiling::Progress::begin("supersample", image->size, pass + 1,
+                                   passes);
+        Buffer<Sample> &superSampled = storage->superSampled;
+        superSampled.resize(image->size);
 
         // For each pixel in the image:
         for (size_t index = 0; index < image->size; index++) {
+                const profiling::Work work(1);
+
                 // Get the pixel coordinates.
                 const size_t x = image::x(index, image->width);
                 const size_t y = image::y(index, image->width);
 
                 // Get the previously sampled pixel value.
-                Colour pixel = sampled[image::index(x + 1, y + 1,
-                                                    borderedWidth)];
+                const Sample sample = sampled[image::index(x + 1, y + 1,
+                                                           borderedWidth)];
 
-                // Create a list of all neighbouring element indices.
+                // Create a list of all neighbouring element indices,
+                // in bordered coordinates.
                 const std::array<size_t, 8> neighbour_indices = {
-                        image::index(x - 1, y - 1, borderedWidth),
-                        image::index(x,     y - 1, borderedWidth),
-                        image::index(x + 1, y - 1, borderedWidth),
-                        image::index(x - 1, y,     borderedWidth),
+                        image::index(x,     y,     borderedWidth),
                         image::index(x + 1, y,     borderedWidth),
-                        image::index(x - 1, y + 1, borderedWidth),
+                        image::index(x + 2, y,     borderedWidth),
                         image::index(x,     y + 1, borderedWidth),
-                        image::index(x + 1, y + 1, borderedWidth)
+                        image::index(x + 2, y + 1, borderedWidth),
+                        image::index(x,     y + 2, borderedWidth),
+                        image::index(x + 1, y + 2, borderedWidth),
+                        image::index(x + 2, y + 2, borderedWidth)
                 };
 
                 // Calculate the difference between the neighbouring
                 // pixel values.
                 Scalar diffSum = 0;
                 for (const auto neighbour_index : neighbour_indices) {
-                        const auto diff = pixel.diff(sampled[neighbour_index]);
+                        const auto diff = sample.diff(sampled[neighbour_index]);
                         diffSum += diff;
                 }
 
                 // If the difference is above a given threshold,
                 // recursively supersample the pixel.
+                size_t samples = 1;
+                size_t depth = 0;
                 if (diffSum > maxPixelDiff * neighbour_indices.size()) {
-                        pixel = renderRegion(x, y, 1, transformMatrix);
+                        const profiling::Span span("supersample", index, 1);
+                        const Cost start;
+
+                        superSampled[index] = Sample(
+                            renderRegion(x, y, 1, transformMatrix,
+                                         quality(x, y), &samples, &depth));
+
+                        if (aux)
+                                aux->addCost(index, start);
+                } else {
+                        superSampled[index] = sample;
                 }
+                profiling::counters::addSupersampleDepth(depth);
 
-                // Set new value.
-                superSampled[index] = pixel;
+                // Record auxiliary outputs.
+                if (aux && aux->enabled(AuxiliaryBuffers::SampleCount))
+                        aux->sampleCount[index] =
+                                        static_cast<uint32_t>(samples);
         }
 
+        supersample.end();
+
+        // Denoise the image, if required.
+        const profiling::Phase postProcess("post-process");
+        if (denoiser)
+                denoiser->denoise(&superSampled, &storage->filtered, *guides,
+                                  image->width, image->height);
+
         // Write pixel information to image.
         for (size_t index = 0; index < image->size; index++)
-                image->set(index, superSampled[index]);
+                image->set(index, static_cast<Colour>(superSampled[index]));
+
+        // The preview has been consumed.
+        storage->previewWidth = storage->previewHeight = 0;
+
+        profiling::Progress::finish();
+}
+
+template<typename Image>
+void Renderer::preview(Image *const image,
+                       RenderBuffers *const _buffers,
+                       const bool guide,
+                       const size_t pass,
+                       const size_t passes) const {
+        RenderBuffers *const restrict storage =
+                        _buffers ? _buffers : &buffers;
+
+        // Count the work done by this preview.
+        storage->statistics.reset();
+
+        // Create image to camera transformation matrix.
+        const Matrix transformMatrix = transform(image->width,
+                                                 image->height);
+
+        // Reduced sampling settings.
+        const Quality quality = {previewDofSamples, previewLightSamples,
+                                 std::min(maxRayDepth, previewRayDepth)};
+
+        Buffer<float> &variance = storage->previewVariance;
+        if (guide)
+                variance.resize(image->size);
+
+        // Sample the centre of every pixel.
+        const profiling::Phase primary("primary", &storage->statistics);
+        profiling::Progress::begin("preview", image->size, pass, passes);
+        tbb::parallel_for(
+            tbb::blocked_range<size_t>(0, image->size),
+            [&](const tbb::blocked_range<size_t> &range) {
+                    const profiling::Scope scope(&storage->statistics);
+                    const profiling::BusyTimer busy;
+                    const profiling::Span span("tile", range.begin(),
+                                               range.size());
+                    const profiling::Work work(range.size());
+
+                    for (size_t index = range.begin();
+                         index != range.end(); index++) {
+                            const auto x = image::x(index, image->width);
+                            const auto y = image::y(index, image->width);
+                            Hit hit;
+
+                            image->set(index, renderPoint(
+                                x + .5, y + .5, transformMatrix, quality,
+                                guide ? &hit : nullptr,
+                                guide ? &variance[index] : nullptr));
+
+                            // The preview's reflections are too shallow
+                            // to estimate the noise of what a
+                            // reflective surface shows, so treat it as
+                            // noisy.
+                            if (guide && reflective(hit))
+                                    variance[index] = INFINITY;
+                    }
+            });
+
+        storage->previewWidth = guide ? image->width : 0;
+        storage->previewHeight = guide ? image->height : 0;
+
+        profiling::Progress::finish();
+}
+
+template<typename View>
+Colour Renderer::traceScene(const View &view,
+                            const Ray &ray,
+                            const Quality &quality,
+                            const unsigned int depth,
+                            Hit *const restrict hit) const {
+        Colour colour;
+
+        // Bump profiling counter.
+        profiling::counters::incTraceCount();
+
+        // Determine the closet ray-object intersection (if any).
+        Scalar t;
+        size_t index;
+        typename View::Primitive primitive;
+        const profiling::Counter tests =
+                        profiling::instrumentation >= 2 ?
+                        profiling::counters::getThreadIntersectionCount() : 0;
+        const bool intersects = view.intersect(ray, &t, &index, &primitive);
+        if (profiling::instrumentation >= 2)
+                profiling::counters::addTraceTests(
+                    profiling::counters::getThreadIntersectionCount() -
+                    tests);
+
+        // If the ray doesn't intersect any object, do nothing.
+        if (!intersects) {
+                profiling::counters::addReflectionDepth(depth);
+                return colour;
+        }
+
+        // Point of intersection.
+        const Vector intersect = ray.position + ray.direction * t;
+        // Surface normal at point of intersection.
+        const Vector normal = view.normal(primitive, intersect);
+        // Direction between intersection and source ray.
+        const Vector toRay = (ray.position - intersect).normalise();
+        // Material at point of intersection.
+        const MaterialIndex materialIndex = view.surface(primitive,
+                                                         intersect);
+        const Material &material = view.material(materialIndex);
+
+        // Record the hit, if required.
+        if (hit) {
+                hit->distance = static_cast<float>(t);
+                hit->normal = PackedVector(normal);
+                hit->objectId = static_cast<uint32_t>(index + 1);
+                hit->materialId = materialIndex + 1;
+                hit->albedo = Sample(material.colour);
+        }
+
+        // Apply ambient lighting.
+        colour += material.colour * material.ambient;
+
+        // Apply shading from each light source.
+        const profiling::Counter shadowRays =
+                        profiling::instrumentation >= 2 ?
+                        profiling::counters::getThreadShadowRayCount() : 0;
+        view.shade(&colour, intersect, normal, toRay, &material,
+                   quality.lightSamples);
+        if (profiling::instrumentation >= 2)
+                profiling::counters::addShadowRaysPerPoint(
+                    profiling::counters::getThreadShadowRayCount() -
+                    shadowRays);
+
+        // Create reflection ray and recursive evaluate.
+        const Scalar reflectivity = material.reflectivity;
+        if (depth < quality.rayDepth && reflectivity > 0) {
+                // Direction of reflected ray.
+                const Vector reflectionDirection = (normal * 2*(normal ^ toRay)
+                                                    - toRay).normalise();
+                // Create a reflection.
+                const Ray reflection(intersect, reflectionDirection);
+                profiling::counters::incReflectionCount();
+                // Add reflection light.
+                colour += traceScene(view, reflection, quality, depth + 1,
+                                     nullptr) * reflectivity;
+        } else {
+                profiling::counters::addReflectionDepth(depth);
+        }
+
+        return colour;
 }
 
 }  // namespace rt
@@ -0,0 +1,72 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RT_REPORT_H_
+#define RT_REPORT_H_
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+#include "rt/math.h"
+#include "rt/perf.h"
+#include "rt/profiling.h"
+
+namespace rt {
+
+// A machine readable summary of a render: its settings, the work
+// done, and the time spent in each phase. Written as a JSON object by
+// operator<<().
+class Report {
+ public:
+        // The output image.
+        std::string path;
+        size_t width = 0;
+        size_t height = 0;
+
+        // The wall-clock time of the whole render, including the
+        // preview and output.
+        Scalar seconds = 0;
+
+        // The work done by the final render. Must be set.
+        const profiling::Counts *counts = nullptr;
+
+        // The hardware events counted during the final render, if
+        // counted.
+        const profiling::HardwareCounts *hardware = nullptr;
+
+        // The phases of the run, if recorded.
+        const profiling::Phases *phases = nullptr;
+};
+
+std::ostream &operator<<(std::ostream &out, const Report &report);
+
+// Print the phases of a run as an indented tree, with the time spent
+// in each, the instructions per cycle if hardware events were
+// counted, and the thread utilisation of parallel phases.
+void printPhases(const profiling::Phases &phases);
+
+// Print the histograms of a render's counts, collected with full
+// instrumentation, and the fraction of light samplings which were
+// fully lit, partially shadowed, or fully shadowed.
+void printHistograms(const profiling::Counts &counts);
+
+}  // namespace rt
+
+#endif  // RT_REPORT_H_
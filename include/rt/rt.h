@@ -20,13 +20,18 @@
 #ifndef RT_RT_H_
 #define RT_RT_H_
 
+#include <algorithm>
+#include <cinttypes>
 #include <string>
 #include <iostream>
+#include <memory>
 
 #include "tbb/parallel_for.h"
 
+#include "rt/aov.h"
 #include "rt/image.h"
 #include "rt/renderer.h"
+#include "rt/report.h"
 #include "rt/restrict.h"
 
 // A simple ray tacer. Features:
@@ -37,61 +42,231 @@
 //   * Anti-aliasing: Stochastic supersampling.
 namespace rt {
 
-// Render the target image and write output to path. Prints
-// profiling information.
+// Render the target image and write output to path. If "aux" is
+// provided, its enabled auxiliary outputs are rendered in the same
+// pass and written alongside the image. If "previewScale" is
+// non-zero, a preview at 1/previewScale of the image width and
+// height is first rendered and written alongside the image, and if
+// "previewGuide" is set, it guides the render's sampling (see
+// Renderer::preview()). Prints
+// profiling information, including the time spent in each phase. If
+// "reportPath" is not empty, a JSON report of the render is written
+// to it.
 template<typename Image>
 void render(const Renderer &renderer,
             const std::string path,
-            Image *const image) {
+            Image *const image,
+            AuxiliaryBuffers *const aux = nullptr,
+            const size_t previewScale = 0,
+            const bool previewGuide = false,
+            const std::string &reportPath = "") {
         // Print start message.
-        printf("Rendering %lu pixels, with "
-               "%llu objects, and %llu light sources ...\n",
-               image->size,
-               profiling::counters::getObjectsCount(),
-               profiling::counters::getLightsCount());
+        if (profiling::instrumentation)
+                printf("Rendering %lu pixels, with "
+                       "%" PRIu64 " objects, and %" PRIu64 " light "
+                       "sources ...\n",
+                       image->size,
+                       profiling::counters::getObjectsCount(),
+                       profiling::counters::getLightsCount());
+        else
+                printf("Rendering %lu pixels ...\n", image->size);
 
         // Start timer.
         profiling::Timer t = profiling::Timer();
 
+        // Record the phases of the render, unless the caller is
+        // already recording.
+        profiling::Phases ownPhases;
+        profiling::Phases *const phases = profiling::Phases::current() ?
+                        profiling::Phases::current() : &ownPhases;
+        const profiling::Recording recording(phases);
+
+        // The progress passes of the run.
+        const size_t passes = Renderer::renderPasses +
+                        (previewScale ? Renderer::previewPasses : 0);
+
+        // Render and write the preview.
+        if (previewScale) {
+                const profiling::Phase previewPhase("preview");
+                DynamicImage preview(
+                    std::max(image->width / previewScale,
+                             static_cast<size_t>(1)),
+                    std::max(image->height / previewScale,
+                             static_cast<size_t>(1)),
+                    image->saturation,
+                    Colour(1 / image->gamma.r, 1 / image->gamma.g,
+                           1 / image->gamma.b),
+                    image->inverted);
+                renderer.preview(&preview, nullptr, previewGuide, 0,
+                                 passes);
+
+                printf("Rendered %lu pixel preview in %.3f seconds.\n",
+                       preview.size, t.elapsed());
+
+                const std::string previewPath =
+                                image::outputPath(path, "preview");
+                std::cout << "Opening file '" << previewPath << "'..."
+                          << std::endl;
+                {
+                        const auto out =
+                                std::make_unique<std::ofstream>(previewPath);
+                        *out << preview;
+                }
+                std::cout << std::endl;
+        }
+
         // Render the scene to the output file.
-        renderer.render<Image>(image);
+        profiling::Timer renderTimer;
+        const profiling::HardwareCounters *const hardware =
+                        phases->hardware && phases->hardware->available() ?
+                        phases->hardware : nullptr;
+        const profiling::HardwareCounts hardwareStart =
+                        hardware ? hardware->read() :
+                        profiling::HardwareCounts();
+        profiling::Phase renderPhase("render");
+        renderer.render<Image>(image, aux, nullptr,
+                               passes - Renderer::renderPasses, passes);
+        renderPhase.end();
+        const profiling::HardwareCounts hardwareCounts =
+                        hardware ? hardware->read() - hardwareStart :
+                        profiling::HardwareCounts();
 
         // Get elapsed time.
-        Scalar runTime = t.elapsed();
+        Scalar runTime = renderTimer.elapsed();
 
-        // Open the output file.
+        // Open the output file. The stream's buffer is large, so keep
+        // it off the stack.
+        profiling::Phase encode("encode");
         std::cout << "Opening file '" << path << "'..." << std::endl;
-        std::ofstream out;
-        out.open(path);
+        {
+                const auto out = std::make_unique<std::ofstream>(path);
+
+                // Write image to output file.
+                *out << *image;
 
-        // Write image to output file.
-        out << *image;
+                // Close the output file.
+                std::cout << "Closing file '" << path << "'..."
+                          << std::endl;
+                std::cout << std::endl;
+        }
 
-        // Close the output file.
-        std::cout << "Closing file '" << path << "'..." << std::endl;
-        std::cout << std::endl;
-        out.close();
+        // Write auxiliary outputs.
+        if (aux) {
+                aux->write(path, image->width, image->height,
+                           image->inverted);
+                std::cout << std::endl;
+        }
+        encode.end();
 
         // Calculate performance information.
-        profiling::Counter traceCount = profiling::counters::getTraceCount();
-        profiling::Counter rayCount   = profiling::counters::getRayCount();
+        // The counts are large with their histograms, so keep them off
+        // the stack, constructed in place rather than by make_unique(),
+        // which would copy them from a temporary.
+        const std::unique_ptr<const profiling::Counts> totals(
+            new profiling::Counts(renderer.statistics().totals()));
+        const profiling::Counts &counts = *totals;
+        profiling::Counter traceCount = counts.traces;
+        profiling::Counter rayCount   = counts.rays;
         profiling::Counter traceRate  = traceCount / runTime;
         profiling::Counter rayRate    = rayCount / runTime;
         profiling::Counter pixelRate  = image->size / runTime;
         Scalar tracePerPixel = static_cast<Scalar>(traceCount)
                         / static_cast<Scalar>(image->size);
 
-        // Print performance summary.
-        printf("Rendered %lu pixels from %llu traces in %.3f seconds.\n\n",
-               image->size, traceCount, runTime);
-        printf("Render performance:\n");
-        printf("\tRays per second:\t%llu\n", rayRate);
-        printf("\tTraces per second:\t%llu\n", traceRate);
-        printf("\tPixels per second:\t%llu\n", pixelRate);
-        printf("\tTraces per pixel:\t%.2f\n", tracePerPixel);
-}
+        // Print performance summary. Without instrumentation, only
+        // times are known.
+        if (profiling::instrumentation) {
+                printf("Rendered %lu pixels from %" PRIu64 " traces in "
+                       "%.3f seconds.\n\n",
+                       image->size, traceCount, runTime);
+                printf("Render performance:\n");
+                printf("\tRays per second:\t%" PRIu64 "\n", rayRate);
+                printf("\tTraces per second:\t%" PRIu64 "\n", traceRate);
+                printf("\tPixels per second:\t%" PRIu64 "\n", pixelRate);
+                printf("\tTraces per pixel:\t%.2f\n", tracePerPixel);
+        } else {
+                printf("Rendered %lu pixels in %.3f seconds.\n\n",
+                       image->size, runTime);
+                printf("Render performance:\n");
+                printf("\tPixels per second:\t%" PRIu64 "\n", pixelRate);
+        }
 
+        // Print the full instrumentation counts, per trace or shadow
+        // ray.
+        if (profiling::instrumentation >= 2) {
+                const auto ratio = [](const profiling::Counter n,
+                                      const profiling::Counter d) {
+                        return d ? static_cast<double>(n) / d : 0.0;
+                };
+                const profiling::Counter primaryIntersections =
+                                counts.intersections -
+                                counts.shadowIntersections;
 
+                printf("\nRender instrumentation:\n");
+                printf("\tReflections per trace:\t%.3f\n",
+                       ratio(counts.reflections, traceCount));
+                printf("\tTests per trace:\t%.2f\n",
+                       ratio(primaryIntersections, traceCount));
+                printf("\tShadow rays per trace:\t%.2f\n",
+                       ratio(counts.shadowRays, traceCount));
+                printf("\tTests per shadow ray:\t%.2f\n",
+                       ratio(counts.shadowIntersections,
+                             counts.shadowRays));
+                printf("\tShadow rays blocked:\t%.1f%%\n",
+                       100 * ratio(counts.shadowRays - rayCount,
+                                   counts.shadowRays));
+                if (counts.chunkVisits)
+                        printf("\tChunk visits per trace:\t%.2f\n",
+                               ratio(counts.chunkVisits, traceCount));
+
+                printHistograms(counts);
+        }
+
+        // Print the hardware events of the render, per ray cast.
+        if (hardware) {
+                const profiling::Counter rays =
+                                counts.traces + counts.shadowRays;
+
+                printf("\nHardware counters:\n");
+                printf("\tCycles:\t\t\t%" PRIu64 "\n", hardwareCounts.cycles);
+                printf("\tInstructions:\t\t%" PRIu64 "\n",
+                       hardwareCounts.instructions);
+                printf("\tInstructions per cycle:\t%.2f\n",
+                       hardwareCounts.ipc());
+                printf("\tCache misses:\t\t%" PRIu64 "\n",
+                       hardwareCounts.cacheMisses);
+                printf("\tBranch misses:\t\t%" PRIu64 "\n",
+                       hardwareCounts.branchMisses);
+                if (rays) {
+                        printf("\tCache misses per ray:\t%.3f\n",
+                               static_cast<double>(
+                                   hardwareCounts.cacheMisses) / rays);
+                        printf("\tBranch misses per ray:\t%.3f\n",
+                               static_cast<double>(
+                                   hardwareCounts.branchMisses) / rays);
+                }
+        }
+
+        // Print the time spent in each phase.
+        printf("\nRender phases:\n");
+        printPhases(*phases);
+
+        // Write the report.
+        if (!reportPath.empty()) {
+                Report report;
+                report.path = path;
+                report.width = image->width;
+                report.height = image->height;
+                report.seconds = t.elapsed();
+                report.counts = totals.get();
+                report.phases = phases;
+                report.hardware = hardware ? &hardwareCounts : nullptr;
+
+                std::cout << "\nWriting report '" << reportPath << "'..."
+                          << std::endl;
+                *std::make_unique<std::ofstream>(reportPath) << report;
+        }
+}
 
 }  // namespace rt
 
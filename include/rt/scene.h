@@ -20,8 +20,10 @@
 #ifndef RT_SCENE_H_
 #define RT_SCENE_H_
 
+#include <utility>
 #include <vector>
 
+#include "rt/arena.h"
 #include "rt/lights.h"
 #include "rt/objects.h"
 
@@ -31,20 +33,23 @@ namespace rt {
 // lights).
 class Scene {
  public:
+        const Materials materials;
         const Objects objects;
         const Lights lights;
 
-        // Constructor.
-        inline Scene(const Objects &_objects,
+        // Constructor. The scene takes over the arena which owns
+        // its objects and lights, and the table of materials which
+        // they refer to.
+        inline Scene(Arena &&_arena,
+                     Materials &&_materials,
+                     const Objects &_objects,
                      const Lights &_lights)
-                : objects(_objects), lights(_lights) {}
-
-        inline ~Scene() {
-                for (auto object : objects)
-                        delete object;
-                for (auto light : lights)
-                        delete light;
-        }
+                : materials(std::move(_materials)),
+                  objects(_objects), lights(_lights),
+                  arena(std::move(_arena)) {}
+
+ private:
+        Arena arena;
 };
 
 }  // namespace rt
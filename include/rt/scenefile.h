@@ -0,0 +1,134 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RT_SCENEFILE_H_
+#define RT_SCENEFILE_H_
+
+#include <string>
+#include <vector>
+
+#include "rt/camera.h"
+#include "rt/graphics.h"
+#include "rt/math.h"
+#include "rt/objects.h"
+#include "rt/scene.h"
+
+namespace rt {
+
+class ChunkCache;
+
+namespace sceneformat {
+class Storage;
+}  // namespace sceneformat
+
+/*
+ * A runtime loader for the ".rt" scene description format, which is
+ * also translated to C++ by scripts/mkscene.py. A scene file is a
+ * list of sections, each a "[Name]" header followed by "Key: value"
+ * pairs. "#" starts a comment. Files support the directives:
+ *
+ *   @def <name> <value>   Define a macro. "@name" is replaced by value.
+ *   @import <path>        Include another file, relative to this one.
+ *
+ * Materials, lenses, and films are named in their section header
+ * (e.g. "[Material.mirror]"), and referenced from other sections as
+ * "$Material.mirror", "$Lens.wide", and "$Film.square".
+ *
+ * Scenes may also be converted to the binary format described in
+ * rt/sceneformat.h, which is memory mapped when loaded. The spheres
+ * of a binary scene may be partitioned into chunks, which can be
+ * loaded on demand (see rt/chunks.h).
+ */
+class SceneFile {
+ public:
+        // Create a scene file which takes ownership of a scene and
+        // its camera. The remaining settings take their default
+        // values.
+        SceneFile(const Scene *const _scene, const Camera *const _camera);
+
+        ~SceneFile();
+
+        // The scene and its camera, owned by the scene file.
+        const Scene *scene;
+        const Camera *camera;
+
+        // The chunks of a scene loaded out of core, or nullptr. Its
+        // spheres are not part of the scene.
+        const ChunkCache *chunks;
+
+        // Renderer configuration:
+
+        // The maximum depth to trace reflected rays to:
+        size_t rayDepth;
+        // Number of samples to make for depth of field:
+        size_t dofSamples;
+        // The output image path:
+        std::string path;
+
+        // The output image scale factor, relative to the film size:
+        size_t scale;
+
+        // Image configuration:
+        Scalar saturation;
+        Colour gamma;
+
+        // Return the output image dimensions, which are the film
+        // size multiplied by the scale factor.
+        auto inline width() const {
+                return static_cast<size_t>(camera->width) * scale;
+        }
+
+        auto inline height() const {
+                return static_cast<size_t>(camera->height) * scale;
+        }
+
+        // Read and parse a scene file, in either the text or binary
+        // format. Returns nullptr and sets "error" to a description
+        // of the problem, prefixed by its file and line, if the file
+        // cannot be loaded. The caller takes ownership of the
+        // returned scene file. If "cacheSize" is non-zero and the
+        // file is a chunked binary scene, its spheres are loaded on
+        // demand into a cache of at most "cacheSize" bytes.
+        static SceneFile *load(const std::string &path,
+                               std::string *const error,
+                               const size_t cacheSize = 0);
+
+        // Write the scene in the binary format. If "chunkSize" is
+        // non-zero, spheres are partitioned into spatial chunks of at
+        // most "chunkSize" spheres. Returns false and sets "error" if
+        // the file cannot be written.
+        bool write(const std::string &destination,
+                   std::string *const error,
+                   const size_t chunkSize = 0) const;
+
+ private:
+        SceneFile();
+
+        // Load a file in the binary format.
+        static SceneFile *loadBinary(const std::string &path,
+                                     std::string *const error,
+                                     const size_t cacheSize);
+
+        // The mapped file of a binary scene, or nullptr.
+        sceneformat::Storage *storage;
+};
+
+}  // namespace rt
+
+#endif  // RT_SCENEFILE_H_
@@ -0,0 +1,185 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RT_SCENEFORMAT_H_
+#define RT_SCENEFORMAT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "rt/objects.h"
+
+namespace rt {
+
+/*
+ * The binary scene format, written by "rtconvert" and loaded by
+ * SceneFile::load(). A binary scene is a Header followed by one
+ * flat array of records for each of materials, spheres, planes,
+ * checkerboards, and lights, and the output path. Arrays are
+ * aligned to 64 bytes. Objects refer to materials by their index
+ * in the materials array, which is loaded as the scene's material
+ * table.
+ *
+ * Spheres may be partitioned into spatial chunks, each a contiguous
+ * run of the spheres array and the bounding box of its spheres, so
+ * that a scene can be rendered without holding all of its spheres in
+ * memory (see rt/chunks.h). Unchunked files have no chunks.
+ *
+ * Files are memory mapped, and the materials array is used in place
+ * as an array of rt::Material, so a file is only portable between
+ * machines with the same byte order and floating point format. Any
+ * change to the layout of a record or of Material requires a new
+ * version number.
+ */
+namespace sceneformat {
+
+// The first eight bytes of every binary scene.
+static constexpr char magic[8] = { 'r', 't', 's', 'c', 'e', 'n', 'e', 0 };
+
+// The format version.
+static constexpr uint32_t version = 3;
+
+// Written in native byte order, to detect foreign files.
+static constexpr uint32_t byteOrderMark = 0x01020304;
+
+// The alignment of every array in the file.
+static constexpr uint64_t alignment = 64;
+
+// The location of a flat array of records.
+class Array {
+ public:
+        uint64_t offset;  // Bytes from the start of the file.
+        uint64_t count;   // Number of records.
+};
+
+class CameraRecord {
+ public:
+        double position[3];
+        double lookAt[3];
+        double width;
+        double height;
+        double focalLength;
+        double aperture;
+        double focus;
+};
+
+class SettingsRecord {
+ public:
+        uint64_t rayDepth;
+        uint64_t dofSamples;
+        uint64_t scale;
+        double saturation;
+        double gamma[3];
+};
+
+class Header {
+ public:
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrderMark;
+        Array materials;
+        Array spheres;
+        Array planes;
+        Array checkerBoards;
+        Array lights;
+        Array chunks;
+        Array path;  // The output path, as chars.
+        CameraRecord camera;
+        SettingsRecord settings;
+};
+
+// Laid out identically to rt::Material, so that the array can be
+// used in place.
+class MaterialRecord {
+ public:
+        double colour[3];
+        double ambient;
+        double diffuse;
+        double specular;
+        double shininess;
+        double reflectivity;
+};
+
+class SphereRecord {
+ public:
+        double position[3];
+        double radius;
+        uint64_t material;
+};
+
+class PlaneRecord {
+ public:
+        double position[3];
+        double direction[3];
+        uint64_t material;
+};
+
+class CheckerBoardRecord {
+ public:
+        double position[3];
+        double direction[3];
+        double checkerWidth;
+        uint64_t material1;
+        uint64_t material2;
+};
+
+class LightRecord {
+ public:
+        double position[3];
+        double colour[3];
+        double radius;
+        uint64_t samples;
+};
+
+class ChunkRecord {
+ public:
+        double min[3];   // Bounding box of the chunk's spheres.
+        double max[3];
+        Array spheres;   // A run of the spheres array.
+};
+
+static_assert(std::is_same<Scalar, double>::value,
+              "binary scenes store Scalars as doubles");
+static_assert(std::is_standard_layout<Material>::value &&
+              sizeof(Material) == sizeof(MaterialRecord) &&
+              offsetof(Material, colour) == offsetof(MaterialRecord, colour) &&
+              offsetof(Material, reflectivity) ==
+              offsetof(MaterialRecord, reflectivity),
+              "Material layout has changed, update MaterialRecord "
+              "and the format version");
+
+// The memory mapped file of a loaded binary scene.
+class Storage {
+ public:
+        inline Storage(void *const _data, const size_t _size)
+                : data(_data), size(_size) {}
+
+        // Unmap the file.
+        ~Storage();
+
+        void *const data;
+        const size_t size;
+};
+
+}  // namespace sceneformat
+
+}  // namespace rt
+
+#endif  // RT_SCENEFORMAT_H_
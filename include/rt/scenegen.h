@@ -0,0 +1,77 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RT_SCENEGEN_H_
+#define RT_SCENEGEN_H_
+
+#include <cstddef>
+#include <string>
+
+#include "rt/random.h"
+#include "rt/scenefile.h"
+
+namespace rt {
+
+// Reproducible synthetic scenes for measuring how rendering scales
+// with scene size. The same parameters always generate the same
+// scene.
+namespace scenegen {
+
+enum class Layout : size_t {
+        // "count" spheres scattered at random through a cube whose
+        // volume grows with the count, above a checkerboard.
+        Spheres,
+        // "count" spheres in a square grid on a checkerboard.
+        Grid,
+        // A grid of 16 spheres lit by "count" soft lights.
+        Lights,
+        // "count" spheres between two facing mirrors, viewed at an
+        // angle so that rays reflect up to the maximum ray depth.
+        Mirrors
+};
+
+class Parameters {
+ public:
+        Layout layout = Layout::Spheres;
+        // The number of primitives, or lights for Layout::Lights.
+        size_t count = 1000;
+        // The number of soft lights, ignored for Layout::Lights.
+        size_t lights = 1;
+        // Samples per soft light. Lights are points if 1.
+        size_t lightSamples = 1;
+        // The maximum depth to trace reflected rays to.
+        size_t rayDepth = 100;
+        // The output image scale factor, relative to a 36x36 film.
+        size_t scale = 2;
+        Seed seed = 1;
+};
+
+// Look up a layout by its lower case name. Returns false if there is
+// no such layout.
+bool layout(const std::string &name, Layout *const out);
+
+// Generate a scene. The caller takes ownership of the returned scene
+// file.
+SceneFile *generate(const Parameters &parameters);
+
+}  // namespace scenegen
+
+}  // namespace rt
+
+#endif  // RT_SCENEGEN_H_
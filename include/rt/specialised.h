@@ -0,0 +1,269 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RT_SPECIALISED_H_
+#define RT_SPECIALISED_H_
+
+#include <array>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "rt/lights.h"
+#include "rt/objects.h"
+#include "rt/profiling.h"
+#include "rt/random.h"
+#include "rt/renderer.h"
+
+namespace rt {
+
+// A round light source whose properties are known at compile
+// time. Equivalent to a SoftLight.
+class StaticLight {
+ public:
+        const Vector position;
+        const Colour colour;
+        const Scalar radius;
+        const size_t samples;
+
+        // Constructor.
+        constexpr StaticLight(const Vector &_position,
+                              const Colour &_colour,
+                              const Scalar _radius,
+                              const size_t _samples)
+                : position(_position), colour(_colour), radius(_radius),
+                  samples(_samples) {}
+};
+
+// A renderer for a scene whose contents are fixed at compile time,
+// as generated by "mkscene.py --specialise". The scene is described
+// by a "Specification" class, which provides:
+//
+//   static constexpr std::array<Material, N> materials;
+//   static constexpr std::array<StaticLight, M> lights;
+//   typedef std::tuple<std::array<T, K>...> Primitives;
+//
+// Primitives are stored in an array per type, and are intersected
+// and shaded using statically dispatched calls, which the compiler
+// can inline. Materials and lights are compile time constants. The
+// generic scene is used only by the base Renderer, and should
+// contain the same objects and lights.
+template<typename Specification>
+class SpecialisedRenderer : public Renderer {
+ public:
+        typedef typename Specification::Primitives Primitives;
+
+        SpecialisedRenderer(const Scene &_scene,
+                            const Primitives &_primitives,
+                            const rt::Camera *const restrict _camera,
+                            const size_t _numDofSamples = 1,
+                            const size_t _maxRayDepth   = 5000,
+                            const Denoiser *const _denoiser = nullptr)
+                : Renderer(_scene, _camera, _numDofSamples, _maxRayDepth,
+                           _denoiser),
+                  primitives(_primitives),
+                  samplers(makeSamplers(
+                      std::make_index_sequence<numLights>())) {}
+
+        const Primitives primitives;
+
+ protected:
+        virtual Colour trace(const Ray &ray,
+                             const Quality &quality,
+                             const unsigned int depth = 0,
+                             Hit *const restrict hit = nullptr) const {
+                return traceScene(View(*this), ray, quality, depth, hit);
+        }
+
+ private:
+        static constexpr size_t numTypes = std::tuple_size<Primitives>::value;
+        static constexpr size_t numLights = Specification::lights.size();
+
+        // Light source samplers, one per light.
+        mutable std::array<UniformDistribution, numLights> samplers;
+
+        // The location of a primitive: the index of its type, and its
+        // index within the array of that type.
+        class Location {
+         public:
+                size_t type;
+                size_t index;
+        };
+
+        // The scene representation for Renderer::traceScene().
+        class View {
+         public:
+                typedef Location Primitive;
+
+                explicit inline View(const SpecialisedRenderer &_renderer)
+                                : renderer(_renderer) {}
+
+                inline bool intersect(const Ray &ray,
+                                      Scalar *const restrict t,
+                                      size_t *const restrict index,
+                                      Primitive *const restrict closest)
+                                const {
+                        bool found = false;
+                        size_t offset = 0;
+                        *t = INFINITY;
+                        *index = 0;
+
+                        renderer.forEach([&](const auto &array,
+                                             const size_t type) {
+                                typedef typename std::decay_t<
+                                        decltype(array)>::value_type T;
+
+                                for (size_t i = 0; i < array.size(); i++) {
+                                        const T &object = array[i];
+                                        const Scalar current =
+                                                object.T::intersect(ray);
+
+                                        if (current != 0 && current < *t) {
+                                                *t = current;
+                                                *index = offset + i;
+                                                closest->type = type;
+                                                closest->index = i;
+                                                found = true;
+                                        }
+                                }
+                                offset += array.size();
+                        });
+
+                        // Bump profiling counter.
+                        profiling::counters::incIntersectionCount(offset);
+
+                        return found;
+                }
+
+                inline Vector normal(const Primitive &primitive,
+                                     const Vector &point) const {
+                        return renderer.template dispatch<Vector>(
+                            primitive, [&](const auto &object) {
+                                    typedef std::decay_t<decltype(object)> T;
+                                    return object.T::normal(point);
+                            });
+                }
+
+                inline MaterialIndex surface(const Primitive &primitive,
+                                             const Vector &point) const {
+                        return renderer.template dispatch<MaterialIndex>(
+                            primitive, [&](const auto &object) {
+                                    typedef std::decay_t<decltype(object)> T;
+                                    return object.T::surface(point);
+                            });
+                }
+
+                inline const Material &material(
+                    const MaterialIndex index) const {
+                        return Specification::materials[index];
+                }
+
+                inline void shade(Colour *const restrict colour,
+                                  const Vector &point,
+                                  const Vector &normal,
+                                  const Vector &toRay,
+                                  const Material *const restrict material,
+                                  const size_t maxSamples) const {
+                        const auto occluded = [&](const Ray &ray,
+                                                  const Scalar distance) {
+                                return renderer.occluded(ray, distance);
+                        };
+
+                        for (size_t i = 0; i < numLights; i++) {
+                                const StaticLight &light =
+                                                Specification::lights[i];
+
+                                *colour += shadeSoftLight(
+                                    light.position, light.colour,
+                                    light.samples, &renderer.samplers[i],
+                                    point, normal, toRay, material,
+                                    maxSamples, occluded);
+                        }
+                }
+
+         private:
+                const SpecialisedRenderer &renderer;
+        };
+
+        // Create a sampler for each light, matching SoftLight.
+        template<size_t... I>
+        static std::array<UniformDistribution, numLights> makeSamplers(
+            std::index_sequence<I...>) {
+                return {{UniformDistribution(-Specification::lights[I].radius,
+                                             Specification::lights[I].radius)
+                         ...}};
+        }
+
+        // Call "f(array, type)" for the array of each primitive type,
+        // in order.
+        template<typename F>
+        inline void forEach(const F &f) const {
+                forEach(f, std::make_index_sequence<numTypes>());
+        }
+
+        template<typename F, size_t... I>
+        inline void forEach(const F &f, std::index_sequence<I...>) const {
+                using expand = int[];
+                (void)expand{0, (f(std::get<I>(primitives), I), 0)...};
+        }
+
+        // Return "f(object)" for the primitive at a location.
+        template<typename Result, size_t I = 0, typename F>
+        inline typename std::enable_if<(I + 1 < numTypes), Result>::type
+        dispatch(const Location &location, const F &f) const {
+                if (location.type == I)
+                        return f(std::get<I>(primitives)[location.index]);
+                return dispatch<Result, I + 1>(location, f);
+        }
+
+        template<typename Result, size_t I = 0, typename F>
+        inline typename std::enable_if<(I + 1 == numTypes), Result>::type
+        dispatch(const Location &location, const F &f) const {
+                return f(std::get<I>(primitives)[location.index]);
+        }
+
+        // Return whether a ray intersects any primitive within a
+        // given distance.
+        inline bool occluded(const Ray &ray, const Scalar distance) const {
+                bool blocked = false;
+                size_t tested = 0;
+
+                forEach([&](const auto &array, const size_t) {
+                        typedef typename std::decay_t<
+                                decltype(array)>::value_type T;
+
+                        for (size_t i = 0; !blocked && i < array.size(); i++) {
+                                const Scalar t = array[i].T::intersect(ray);
+                                tested++;
+                                if (t > 0 && t < distance)
+                                        blocked = true;
+                        }
+                });
+
+                // Bump profiling counter.
+                profiling::counters::incIntersectionCount(tested);
+
+                return blocked;
+        }
+};
+
+}  // namespace rt
+
+#endif  // RT_SPECIALISED_H_
@@ -0,0 +1,128 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RT_TIMELINE_H_
+#define RT_TIMELINE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "tbb/enumerable_thread_specific.h"
+
+namespace rt {
+
+namespace profiling {
+
+// A recording of timed spans on each thread, such as the tiles of
+// the parallel passes, written in the Chrome trace event format for
+// viewing in chrome://tracing or Perfetto. Each thread records into
+// its own buffer, without locking. Buffers must not be written while
+// the timeline is being written out.
+class Timeline {
+ public:
+        typedef std::chrono::steady_clock::time_point Time;
+
+        Timeline();
+
+        Timeline(const Timeline &) = delete;
+        Timeline &operator=(const Timeline &) = delete;
+
+        // Record a span on the calling thread. The name must outlive
+        // the timeline. "index" and "count" are recorded as
+        // arguments if "count" is non-zero.
+        void record(const char *const name,
+                    const Time start,
+                    const Time end,
+                    const uint64_t index = 0,
+                    const uint64_t count = 0);
+
+        // Return the number of spans recorded.
+        size_t size() const;
+
+        // Return the active timeline, if any.
+        static Timeline *active();
+
+        friend std::ostream &operator<<(std::ostream &out,
+                                        const Timeline &timeline);
+
+ private:
+        class Event {
+         public:
+                const char *name;
+                Time start;
+                Time end;
+                uint64_t index;
+                uint64_t count;
+        };
+
+        class Buffer {
+         public:
+                size_t thread;
+                std::vector<Event> events;
+        };
+
+        const Time epoch;
+        // The number of threads which have recorded, used to number
+        // them.
+        std::atomic<size_t> threads;
+        tbb::enumerable_thread_specific<Buffer> buffers;
+};
+
+// Make a timeline the active timeline of all threads for the
+// lifetime of the scope.
+class Tracing {
+ public:
+        explicit Tracing(Timeline *const timeline);
+        ~Tracing();
+
+        Tracing(const Tracing &) = delete;
+        Tracing &operator=(const Tracing &) = delete;
+
+ private:
+        Timeline *const previous;
+};
+
+// Record a span on the calling thread for the lifetime of the scope,
+// if there is an active timeline. The name must outlive the timeline.
+class Span {
+ public:
+        explicit Span(const char *const name,
+                      const uint64_t index = 0,
+                      const uint64_t count = 0);
+        ~Span();
+
+        Span(const Span &) = delete;
+        Span &operator=(const Span &) = delete;
+
+ private:
+        Timeline *const timeline;
+        const char *const name;
+        const uint64_t index;
+        const uint64_t count;
+        Timeline::Time start;
+};
+
+}  // namespace profiling
+
+}  // namespace rt
+
+#endif  // RT_TIMELINE_H_
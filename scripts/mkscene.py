@@ -17,10 +17,10 @@
 # You should have received a copy of the GNU General Public License
 # along with rt.  If not, see <http://www.gnu.org/licenses/>.
 
+from concurrent.futures import ProcessPoolExecutor
 from copy import copy
 from math import ceil
-from os.path import abspath
-from random import randint
+from os.path import abspath,dirname,join
 from re import compile,search,sub
 from sys import argv,exit,stdout
 
@@ -45,88 +45,93 @@ def fatal(*args, **kwargs):
     print("[FATAL ]", *args, **kwargs)
     exit(1)
 
-def tokenise(characters):
-    # Parser state.
-    in_quotes = False
-    in_comment = False
-    tokens = []
-    buf = "" # Token buffer.
-
-    # Iterate over characters:
-    for c in characters:
-        # If it's a comment character, set "in_comment" flag.
-        if c == '#':
-            in_comment = True
-        # If it's the end of a line, reset the "in_comment" flag, but
-        # *don't* empty the buffer if we're in quotes, to support
-        # multi-line strings.
-        elif c == "\n" or c == "\r":
-            in_comment = False
-            if in_quotes:
-                buf += c
-            else:
-                if buf:
-                    tokens.append(buf)
-                    buf = ""
-            continue
+# Quoted strings (which may span lines) and comments, which run from
+# a "#" to the end of the line. Everything between them is split into
+# tokens at whitespace.
+quote_or_comment_re = compile(r'("[^"]*"?|#[^\r\n]*)')
 
-        # If we're in a comment, do nothing.
-        if in_comment:
-            continue
+# Return an iterator over the tokens of a string. Rather than stepping
+# through characters, the string is split at quotes and comments, and
+# the text in between with str.split(), so that the scanning is done
+# by the regex engine.
+def tokenise(characters):
+    pieces = quote_or_comment_re.split(characters)
+
+    for i in range(0, len(pieces), 2):
+        yield from pieces[i].split()
+
+        if i + 1 < len(pieces) and pieces[i + 1][0] == '"':
+            # Strip the quotation marks from a string.
+            string = pieces[i + 1][1:]
+            if string.endswith('"'):
+                string = string[:-1]
+            if string:
+                yield string
+
+# Return the absolute path to a file. Relative paths are relative to
+# the directory of the importing file "base", if any, as in the C++
+# scene loader, or else to the working directory.
+def get_path(path, base=None):
+    if base:
+        path = join(dirname(base), path)
+    return abspath(path)
 
-        # If it's a quote character determine whether we're opening or
-        # closing a quote. If we're closing, then dump the quoted
-        # characters (excluding the surrounding "" quotation marks).
-        if c == '"':
-            if in_quotes:
-                in_quotes = False
-                if buf:
-                    tokens.append(buf)
-                    buf = ""
-            else:
-                in_quotes = True
-                if buf:
-                    tokens.append(buf)
-                    buf = ""
-        # If we're at a word break, dump the buffer, except if we're
-        # in quotes.
-        elif c == " " or c == "\t":
-            if in_quotes:
-                buf += c
-            else:
-                if buf:
-                    tokens.append(buf)
-                    buf = ""
-        # Fall-through state: we're in a normal word.
+# Read and tokenise a file. Returns the tokens and the paths of its
+# literal @import statements, or None if the file cannot be read. Run
+# in worker processes, so must not exit.
+def scan_file(path):
+    try:
+        with open(path) as infile:
+            tokens = list(tokenise(infile.read()))
+    except FileNotFoundError:
+        return None
+
+    imports = [get_path(tokens[i + 1], path) for i in range(len(tokens) - 1)
+               if tokens[i].lower() == "@import" and tokens[i + 1][0] != "@"]
+    return tokens, imports
+
+# Reads the files of an @import tree. Imported files are read and
+# tokenised concurrently in a pool of worker processes, starting as
+# soon as the file which imports them has been read, while the main
+# process expands the files in order.
+class Reader:
+    def __init__(self):
+        self.pool = None
+        self.pending = {}
+
+    # Start reading a file in the background, if not already.
+    def prefetch(self, path):
+        if path not in self.pending:
+            if not self.pool:
+                self.pool = ProcessPoolExecutor()
+            self.pending[path] = self.pool.submit(scan_file, path)
+
+    # Return the tokens of a file.
+    def read(self, path):
+        path = get_path(path)
+        if path in self.pending:
+            result = self.pending.pop(path).result()
         else:
-            buf += c
+            # The top-level file is read without a worker, as most
+            # scenes have no imports.
+            result = scan_file(path)
 
-    # Flush the last token (if any).
-    if buf:
-        tokens.append(buf)
-
-    return tokens
+        if result is None:
+            fatal("No such file or directory: '{0}'.".format(path))
+        tokens, imports = result
 
-# Return the absolute path to a file.
-def get_path(path):
-    return abspath(path)
-
-# Accepts a line and returns the path to an @import statement, if
-# found. Else, returns false.
-def is_import_macro(line):
-    match = search(import_re, line)
+        if verbosity["debug"]["file_paths"]:
+            debug("Read '{0}'".format(path))
+        for imported in imports:
+            self.prefetch(imported)
 
-    if match:
-        return get_path(match.group("path"))
-    else:
-        return False
+        return tokens
 
-def preprocess(tokens):
-    return tokens
+    def close(self):
+        if self.pool:
+            self.pool.shutdown()
 
-# Strip a line of comments and whitespace.
-def strip_line(line):
-    return sub(comment_re, "", line.strip())
+reader = Reader()
 
 def lookup_macro(word, macros):
     if word[0] != "@":
@@ -142,20 +147,28 @@ def lookup_macro(word, macros):
     else:
         return word
 
-def preprocess(tokens, macros={}):
-    processed = []
+# Expand macros, @def, and @import statements in a stream of tokens
+# read from "path".
+def preprocess(tokens, macros, path):
     next_token_def = False
     next_token_def_val = False
     next_token_import = False
 
     for token in tokens:
+        # Most tokens are neither macros nor the operands of a
+        # statement, so pass them straight through.
+        if (token[0] != "@" and not next_token_import and
+            not next_token_def and not next_token_def_val):
+            yield token
+            continue
+
         # First expand macros.
         token = lookup_macro(token, macros)
         lowertoken = token.lower()
 
         if next_token_import:
             # Expand @import statements.
-            processed += get_tokens(token, macros)
+            yield from get_tokens(get_path(token, path), macros)
             next_token_import = False
         elif next_token_def:
             # Set macro name.
@@ -175,48 +188,30 @@ def preprocess(tokens, macros={}):
         elif lowertoken == "@def":
             next_token_def = True
         else:
-            processed.append(token)
+            yield token
 
-    return processed
-
-def read_file(path):
-    path = get_path(path)
-    try:
-        lines = open(path).readlines()
-        if verbosity["debug"]["file_paths"]:
-            debug("Read '{0}'".format(path))
-        return lines
-    except FileNotFoundError:
-        fatal("No such file or directory: '{0}'.".format(path))
-
-# Read an input file and return a list of source-tokens, stripped of
-# comments, and recursively expanded @include statements and macros.
-def get_tokens(path, macros={}):
-    # Step 1. Read input file.
-    lines = read_file(path)
-    # Step 2. Tokenise.
-    tokens = tokenise("".join(lines))
-    # Step 3. Pre-process tokens.
-    tokens = preprocess(tokens)
-
-    return tokens
+# Return an iterator over the source-tokens of an input file, stripped
+# of comments, and with recursively expanded @import statements and
+# macros. Macros are shared by all files, and take effect from their
+# definition onwards.
+def get_tokens(path, macros):
+    return preprocess(reader.read(path), macros, get_path(path))
 
+# Return an iterator over the sections of a token stream, so that
+# sections are generated as the files are read.
 def get_sections(tokens):
-    sections = []
     buf = []
 
     for token in tokens:
         if token[0] == "[" and token[-1] == "]":
             if buf:
-                sections.append(buf)
+                yield buf
             buf = [token[1:-1]]
         else:
             buf.append(token)
 
     if buf:
-        sections.append(buf)
-
-    return sections
+        yield buf
 
 colour_6_re = compile("^0x[0-9a-f]{6}$")
 
@@ -337,6 +332,9 @@ def set_renderer_softlights(pairs):
 
 
 materials = set()
+# The material table, as a list of (properties, code) pairs. Identical
+# materials share an entry, as they do in rt::Materials.
+material_table = []
 
 def get_material_code(name, pairs):
     colour = consume_colour(pairs, "colour")
@@ -352,16 +350,23 @@ def get_material_code(name, pairs):
     if name in materials:
         fatal("Duplicate material name '{0}'"
               .format(name))
-    materials.add(name);
 
-    return ("const Material *const restrict {name} = "
-            "new Material({colour}, {ambient}, {diffuse}, "
-            "{specular}, {shininess}, {reflectivity});"
-            .format(name=name, colour=colour, ambient=ambient, diffuse=diffuse,
-                    specular=specular, shininess=shininess,
-                    reflectivity=reflectivity))
+    material = ("Material({colour}, {ambient}, {diffuse}, "
+                "{specular}, {shininess}, {reflectivity})"
+                .format(colour=colour, ambient=ambient, diffuse=diffuse,
+                        specular=specular, shininess=shininess,
+                        reflectivity=reflectivity))
+    properties = (colour, float(ambient), float(diffuse), float(specular),
+                  float(shininess), float(reflectivity))
+    if properties not in [key for key, _ in material_table]:
+        material_table.append((properties, material))
+    materials.add(name)
+
+    return ("const MaterialIndex {name} = _materials->add({material});"
+            .format(name=name, material=material))
 
-objects = set()
+# Object names, mapped to their type, in order of definition.
+objects = {}
 
 def get_plane_code(name, pairs):
     position = consume_vector(pairs, "position")
@@ -371,10 +376,10 @@ def get_plane_code(name, pairs):
     if name in objects:
         fatal("Duplicate object name '{0}'"
               .format(name))
-    objects.add(name)
+    objects[name] = "Plane"
 
     return ("const Plane *const restrict {name} = "
-            "new Plane({position}, {direction}, {material});"
+            "arena->make<Plane>({position}, {direction}, {material});"
             .format(name=name, position=position, direction=direction,
                     material=material))
 
@@ -388,10 +393,10 @@ def get_checkerboard_code(name, pairs):
     if name in objects:
         fatal("Duplicate object name '{0}'"
               .format(name))
-    objects.add(name)
+    objects[name] = "CheckerBoard"
 
     return ("const CheckerBoard *const restrict {name} = "
-            "new CheckerBoard({position}, {direction}, {size}, "
+            "arena->make<CheckerBoard>({position}, {direction}, {size}, "
             "{material1}, {material2});"
             .format(name=name, position=position, direction=direction,
                     size=size, material1=material1, material2=material2))
@@ -404,14 +409,16 @@ def get_sphere_code(name, pairs):
     if name in objects:
         fatal("Duplicate object name '{0}'"
               .format(name))
-    objects.add(name)
+    objects[name] = "Sphere"
 
     return ("const Sphere *const restrict {name} = "
-            "new Sphere({position}, {size}, {material});"
+            "arena->make<Sphere>({position}, {size}, {material});"
             .format(name=name, position=position, size=size,
                     material=material))
 
-lights = set()
+# Light names, mapped to their StaticLight definitions, in order of
+# definition.
+lights = {}
 
 def get_softlight_code(name, pairs):
     position = consume_vector(pairs, "position")
@@ -435,10 +442,13 @@ def get_softlight_code(name, pairs):
     if name in lights:
         fatal("Duplicate light name '{0}'"
               .format(name))
-    lights.add(name)
+    lights[name] = ("StaticLight({position}, {colour}, {size}, {samples}UL)"
+                    .format(position=position, colour=colour, size=size,
+                            samples=samples))
 
     return ("const SoftLight *const restrict {name} = "
-            "new SoftLight({position}, {colour}, {size}, {samples});"
+            "arena->make<SoftLight>({position}, {colour}, {size}, "
+            "{samples}UL);"
             .format(name=name, position=position, size=size,
                     colour=colour, samples=samples))
 
@@ -449,10 +459,11 @@ def get_pointlight_code(name, pairs):
     if name in lights:
         fatal("Duplicate light name '{0}'"
               .format(name))
-    lights.add(name)
+    lights[name] = ("StaticLight({position}, {colour}, 0, 1UL)"
+                    .format(position=position, colour=colour))
 
     return ("const SoftLight *const restrict {name} = "
-            "new SoftLight({position}, {colour});"
+            "arena->make<SoftLight>({position}, {colour});"
             .format(name=name, position=position, colour=colour))
 
 def consume_val(pairs, name):
@@ -550,8 +561,13 @@ def get_keyval_pairs(tokens):
 
     return pairs
 
+# Return a new, unique identifier.
 def newid():
-    return "__id{0:09d}__".format(randint(0, 999999999))
+    global ids
+    ids += 1
+    return "__id{0:09d}__".format(ids)
+
+ids = 0
 
 material_re = compile("^material\.")
 film_re = compile("^film\.")
@@ -589,24 +605,138 @@ def get_section_code(section):
         return "// Not implemented: {0}".format(name)
 
 def get_scene_code():
-    c = "const Object *_objects[] = {\n"
-    for object in objects:
-        c += "  {0},\n".format(object)
-    c += "};\n"
-    c += "const Light *_lights[] = {\n"
-    for light in lights:
+    c = ["const Object *_objects[] = {"]
+    c += ["  {0},".format(object) for object in objects]
+    c.append("};")
+    c.append("const Light *_lights[] = {")
+    c += ["  {0},".format(light) for light in lights]
+    c.append("};")
+    c.append("const Objects objects(_objects, _objects + (sizeof(_objects) / sizeof(_objects[0])));")
+    c.append("const Lights lights(_lights, _lights + (sizeof(_lights) / sizeof(_lights[0])));")
+    c.append("const Scene *const restrict scene = "
+             "new Scene(std::move(*arena), std::move(*_materials), "
+             "objects, lights);")
+
+    return "\n".join(c) + "\n"
+
+def get_primitive_types():
+    types = []
+    for type in objects.values():
+        if type not in types:
+            types.append(type)
+    return types
+
+def get_array_type(type, size):
+    return "std::array<{type}, {size}>".format(type=type, size=size)
+
+def get_specification_code():
+    types = get_primitive_types()
+    materials_type = get_array_type("Material", len(material_table))
+    lights_type = get_array_type("StaticLight", len(lights))
+    primitives_type = ", ".join([
+        get_array_type(type, list(objects.values()).count(type))
+        for type in types])
+
+    c = "class Specification {\n"
+    c += " public:\n"
+    c += "static constexpr {0} materials = {{{{\n".format(materials_type)
+    for _, material in material_table:
+        c += "  {0},\n".format(material)
+    c += "}};\n"
+    c += "static constexpr {0} lights = {{{{\n".format(lights_type)
+    for light in lights.values():
         c += "  {0},\n".format(light)
+    c += "}};\n"
+    c += "typedef std::tuple<{0}> Primitives;\n".format(primitives_type)
     c += "};\n"
-    c += "const Objects objects(_objects, _objects + (sizeof(_objects) / sizeof(_objects[0])));\n"
-    c += "const Lights lights(_lights, _lights + (sizeof(_lights) / sizeof(_lights[0])));\n"
-    c += "const Scene *const restrict scene = new Scene(objects, lights);\n"
+    c += "constexpr {0} Specification::materials;\n".format(materials_type)
+    c += "constexpr {0} Specification::lights;\n".format(lights_type)
 
     return c
 
+# The primitives are too large for the stack, so each array is built
+# in place on the heap, and the tuple copied from them.
+def get_primitives_code():
+    c = []
+    arrays = []
+    for i, type in enumerate(get_primitive_types()):
+        names = ["*" + name for name in objects if objects[name] == type]
+        array = "_primitives{0}".format(i)
+        c.append("const auto *const {0} = new {1}{{{{{2}}}}};"
+                 .format(array, get_array_type(type, len(names)),
+                         ", ".join(names)))
+        arrays.append("*" + array)
+
+    c.append("const Specification::Primitives *const primitives = "
+             "new Specification::Primitives({0});"
+             .format(", ".join(arrays)))
+
+    return "\n".join(c)
+
+benchmark_code = """\
+// Compare the render times of the generic and specialised renderers.
+static int benchmark(const Scene &scene,
+                     const Specification::Primitives &primitives,
+                     const Camera *const camera,
+                     const size_t depth,
+                     const size_t width,
+                     const size_t height) {
+  const size_t iterations = 5;
+  // Each renderer has its own copy of the camera, so that both draw
+  // the same sequence of lens samples. The cameras, renderers, and
+  // images are large, so keep them off the stack.
+  const std::unique_ptr<const Camera> genericCamera(new Camera(*camera));
+  const std::unique_ptr<const Camera> specialisedCamera(
+      new Camera(*camera));
+  const std::unique_ptr<const Renderer> generic(
+      new Renderer(scene, genericCamera.get(), 1, depth));
+  const std::unique_ptr<const Renderer> specialised(
+      new SpecialisedRenderer<Specification>(
+          scene, primitives, specialisedCamera.get(), 1, depth));
+  const std::unique_ptr<DynamicImage> genericImage(
+      new DynamicImage(width, height));
+  const std::unique_ptr<DynamicImage> specialisedImage(
+      new DynamicImage(width, height));
+  Scalar genericTime = 0, specialisedTime = 0;
+
+  for (size_t i = 0; i < iterations; i++) {
+    profiling::Timer genericTimer;
+    generic->render(genericImage.get());
+    genericTime += genericTimer.elapsed();
+
+    profiling::Timer specialisedTimer;
+    specialised->render(specialisedImage.get());
+    specialisedTime += specialisedTimer.elapsed();
+  }
+
+  const bool identical = std::equal(
+      genericImage->data.begin(), genericImage->data.end(),
+      specialisedImage->data.begin(), [](const Pixel &a, const Pixel &b) {
+        return a.r == b.r && a.g == b.g && a.b == b.b;
+      });
+
+  printf("Rendering %lux%lu pixels, %lu iterations\\n",
+         width, height, iterations);
+  printf("%-12s %10s\\n", "Renderer", "Time (s)");
+  printf("%-12s %10.3f\\n", "Generic", genericTime / iterations);
+  printf("%-12s %10.3f\\n", "Specialised", specialisedTime / iterations);
+  printf("Speedup: %.2fx, images %s\\n", genericTime / specialisedTime,
+         identical ? "identical" : "differ");
+
+  return identical ? 0 : 1;
+}"""
+
 def get_renderer_code():
     depth = renderer["depth"]
     dofsamples = renderer["dof"]
 
+    if specialise:
+        return ("const Renderer *const renderer = "
+                "new SpecialisedRenderer<Specification>(*{scene}, "
+                "*primitives, {camera}, {dof}, {depth});"
+                .format(scene="scene", camera=camera, depth=depth,
+                        dof=dofsamples))
+
     c = ("Renderer *const renderer = new Renderer(*{scene}, {camera}, "
          "{dof}, {depth});"
          .format(scene="scene", camera=camera, depth=depth,
@@ -636,13 +766,36 @@ def get_code(sections):
     render = []
 
     code.append('#include "rt/rt.h"')
+    if specialise:
+        code.append('#include <algorithm>')
+        code.append('#include <array>')
+        code.append('#include <memory>')
+        code.append('#include <string>')
+        code.append('#include <tuple>')
+        code.append('#include "rt/specialised.h"')
     code.append('using namespace rt;')
 
-    code.append('int main(int argc, char **argv) {')
     for section in sections:
         render.append(get_section_code(section))
     render.append(get_scene_code())
+    if specialise:
+        render.append(get_primitives_code())
+        render.append('if (argc > 1 && std::string(argv[1]) == "--benchmark")')
+        render.append('return benchmark(*scene, *primitives, {camera}, '
+                      '{depth}, {width}, {height});'
+                      .format(camera=camera, depth=renderer["depth"],
+                              width=film["width"], height=film["height"]))
     render.append(get_renderer_code())
+
+    if specialise:
+        code.append(get_specification_code())
+        code.append(benchmark_code)
+
+    code.append('int main(int argc, char **argv) {')
+    # The arena and material table are large, so keep them off the
+    # stack. Their contents are moved into the scene.
+    code.append('Arena *const arena = new Arena();')
+    code.append('Materials *const _materials = new Materials();')
     [code.append(line) for line in render if line]
 
     image = get_image()
@@ -657,15 +810,27 @@ def get_code(sections):
 
     return "\n".join(code)
 
-input = argv[1]
-if len(argv) > 2:
-    output = open(argv[2], "w")
-else:
-    output = stdout
+# With "--specialise", generate a SpecialisedRenderer for the scene,
+# which can be compared against the generic renderer by running the
+# program with "--benchmark".
+specialise = False
+
+if __name__ == "__main__":
+    specialise = "--specialise" in argv[1:]
+    args = [arg for arg in argv[1:] if arg != "--specialise"]
+    if not args:
+        fatal("Usage: mkscene.py [--specialise] <input> [output]")
+
+    input = args[0]
+    if len(args) > 1:
+        output = open(args[1], "w")
+    else:
+        output = stdout
 
-out = output
-tokens = get_tokens(input)
-sections = get_sections(tokens)
-code = get_code(sections)
+    out = output
+    tokens = get_tokens(input, {})
+    sections = get_sections(tokens)
+    code = get_code(sections)
+    reader.close()
 
-print(code, file=out)
+    print(code, file=out)
@@ -0,0 +1,180 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "rt/aov.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "rt/image.h"
+
+namespace rt {
+
+namespace {
+
+// Write an image to a file.
+void writeImage(const std::string &path, const DynamicImage &image) {
+        std::cout << "Opening file '" << path << "'..." << std::endl;
+        std::ofstream out(path);
+        out << image;
+}
+
+// Return a distinct colour for an identifier, or black for zero.
+Colour idColour(const uint32_t id) {
+        if (!id)
+                return Colour();
+
+        // Scatter consecutive identifiers across the colour cube,
+        // keeping every component bright enough to distinguish from
+        // the black background.
+        const uint32_t hash = id * 2654435761U;
+        return Colour(static_cast<int>((hash >> 8) | 0x404040));
+}
+
+// Write a per-pixel count as a heatmap, normalised to the 99th
+// percentile count so that a few outliers (such as pixels whose
+// thread was preempted) do not darken the rest of the map.
+void writeCounts(const std::string &path,
+                 const Buffer<uint32_t> &counts,
+                 DynamicImage *const image) {
+        std::vector<uint32_t> sorted(counts.data(),
+                                     counts.data() + counts.size());
+        const auto percentile = sorted.begin() + static_cast<ptrdiff_t>(
+            sorted.size() * 99 / 100);
+        std::nth_element(sorted.begin(), percentile, sorted.end());
+        const uint32_t max = std::max(*percentile, 1U);
+
+        for (size_t i = 0; i < counts.size(); i++)
+                image->set(i, heat(static_cast<Scalar>(counts[i]) / max));
+
+        writeImage(path, *image);
+}
+
+}  // namespace
+
+AuxiliaryBuffers::AuxiliaryBuffers(const size_t _outputs)
+                : outputs(_outputs) {}
+
+void AuxiliaryBuffers::resize(const size_t size) {
+        if (enabled(Depth))
+                depth.resize(size);
+        if (enabled(Normal))
+                normal.resize(size);
+        if (enabled(ObjectId))
+                objectId.resize(size);
+        if (enabled(MaterialId))
+                materialId.resize(size);
+        if (enabled(SampleCount))
+                sampleCount.resize(size);
+        if (enabled(TraceCount))
+                traceCount.resize(size);
+        if (enabled(Albedo))
+                albedo.resize(size);
+        if (enabled(ShadowRayCount))
+                shadowRayCount.resize(size);
+        if (enabled(IntersectionCount))
+                intersectionCount.resize(size);
+        if (enabled(Time))
+                time.resize(size);
+
+        // Cost outputs are accumulated over each pass of a render.
+        for (Buffer<uint32_t> *const counts : {&sampleCount, &traceCount,
+                                               &shadowRayCount,
+                                               &intersectionCount, &time})
+                if (counts->size())
+                        memset(counts->data(), 0,
+                               counts->size() * sizeof(uint32_t));
+}
+
+void AuxiliaryBuffers::write(const std::string &path,
+                             const size_t width,
+                             const size_t height,
+                             const bool inverted) const {
+        const size_t size = width * height;
+        DynamicImage image(width, height, 1, Colour(1, 1, 1), inverted);
+
+        if (enabled(Depth)) {
+                // Display inverse depth, normalised to the nearest
+                // hit, so that near surfaces are bright and misses
+                // are black. If nothing is hit, the image is black.
+                float min = INFINITY;
+                for (size_t i = 0; i < size; i++)
+                        min = std::min(min, depth[i]);
+
+                for (size_t i = 0; i < size; i++) {
+                        const Scalar v = std::isfinite(min) ?
+                                        min / depth[i] : 0;
+                        image.set(i, Colour(v, v, v));
+                }
+                writeImage(image::outputPath(path, "depth"), image);
+        }
+
+        if (enabled(Normal)) {
+                // Map normal components from [-1,1] to [0,1].
+                for (size_t i = 0; i < size; i++)
+                        image.set(i, Colour((normal[i].x + 1) / 2,
+                                            (normal[i].y + 1) / 2,
+                                            (normal[i].z + 1) / 2));
+                writeImage(image::outputPath(path, "normal"), image);
+        }
+
+        if (enabled(ObjectId)) {
+                for (size_t i = 0; i < size; i++)
+                        image.set(i, idColour(objectId[i]));
+                writeImage(image::outputPath(path, "objectid"), image);
+        }
+
+        if (enabled(MaterialId)) {
+                for (size_t i = 0; i < size; i++)
+                        image.set(i, idColour(materialId[i]));
+                writeImage(image::outputPath(path, "materialid"), image);
+        }
+
+        if (enabled(SampleCount))
+                writeCounts(image::outputPath(path, "samples"), sampleCount,
+                            &image);
+
+        if (enabled(TraceCount))
+                writeCounts(image::outputPath(path, "traces"), traceCount,
+                            &image);
+
+        if (enabled(Albedo)) {
+                for (size_t i = 0; i < size; i++)
+                        image.set(i, static_cast<Colour>(albedo[i]));
+                writeImage(image::outputPath(path, "albedo"), image);
+        }
+
+        if (enabled(ShadowRayCount))
+                writeCounts(image::outputPath(path, "shadowrays"),
+                            shadowRayCount, &image);
+
+        if (enabled(IntersectionCount))
+                writeCounts(image::outputPath(path, "intersections"),
+                            intersectionCount, &image);
+
+        if (enabled(Time))
+                writeCounts(image::outputPath(path, "time"), time, &image);
+}
+
+}  // namespace rt
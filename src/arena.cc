@@ -0,0 +1,81 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "rt/arena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace rt {
+
+namespace {
+
+// The size of the first block, and the largest size that blocks grow
+// to. Larger objects get a block of their own.
+static const size_t minBlockSize = 4096;
+static const size_t maxBlockSize = 16 << 20;
+
+}  // namespace
+
+Arena::Arena()
+                : blocks(nullptr), cursor(nullptr), end(nullptr),
+                  finalisers(nullptr), capacity(0) {}
+
+Arena::~Arena() {
+        for (Finaliser *f = finalisers; f; f = f->next)
+                f->destroy(f->object);
+
+        while (blocks) {
+                Block *const next = blocks->next;
+                ::operator delete(blocks);
+                blocks = next;
+        }
+}
+
+void *Arena::allocate(const size_t size, const size_t alignment) {
+        auto address = reinterpret_cast<uintptr_t>(cursor);
+        address = (address + alignment - 1) / alignment * alignment;
+
+        if (!cursor || address + size > reinterpret_cast<uintptr_t>(end)) {
+                // Double the block size, up to the maximum.
+                const size_t next = blocks ?
+                                std::min(blocks->size * 2, maxBlockSize) :
+                                minBlockSize;
+                const size_t blockSize = std::max(
+                    next, sizeof(Block) + size + alignment);
+                Block *const block = static_cast<Block *>(
+                    ::operator new(blockSize));
+
+                block->next = blocks;
+                block->size = blockSize;
+                blocks = block;
+                capacity += blockSize;
+
+                cursor = reinterpret_cast<char *>(block + 1);
+                end = reinterpret_cast<char *>(block) + blockSize;
+
+                address = reinterpret_cast<uintptr_t>(cursor);
+                address = (address + alignment - 1) / alignment * alignment;
+        }
+
+        cursor = reinterpret_cast<char *>(address + size);
+        return reinterpret_cast<void *>(address);
+}
+
+}  // namespace rt
@@ -0,0 +1,388 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "rt/chunks.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "rt/lights.h"
+#include "rt/profiling.h"
+#include "rt/sceneformat.h"
+
+namespace rt {
+
+namespace {
+
+// A chunk crossed by a ray, and the distance at which the ray
+// enters its bounds.
+class Crossing {
+ public:
+        Scalar entry;
+        size_t index;
+};
+
+// Return whether a ray crosses the bounds of a chunk before a given
+// distance, and if so, set the distance at which it enters them.
+bool crosses(const Ray &ray,
+             const ChunkCache::Entry &chunk,
+             const Scalar limit,
+             Scalar *const restrict entry) {
+        const Scalar origin[3] = {
+                ray.position.x, ray.position.y, ray.position.z
+        };
+        const Scalar direction[3] = {
+                ray.direction.x, ray.direction.y, ray.direction.z
+        };
+        const Scalar min[3] = { chunk.min.x, chunk.min.y, chunk.min.z };
+        const Scalar max[3] = { chunk.max.x, chunk.max.y, chunk.max.z };
+        Scalar near = 0, far = limit;
+
+        for (size_t i = 0; i < 3; i++) {
+                const Scalar inverse = 1 / direction[i];
+                Scalar t0 = (min[i] - origin[i]) * inverse;
+                Scalar t1 = (max[i] - origin[i]) * inverse;
+
+                if (t0 > t1)
+                        std::swap(t0, t1);
+                near = std::max(near, t0);
+                far = std::min(far, t1);
+                if (near > far)
+                        return false;
+        }
+
+        *entry = near;
+        return true;
+}
+
+// Return the resident size of a chunk.
+inline size_t size(const Chunk &chunk) {
+        return chunk.spheres.size() * sizeof(Sphere);
+}
+
+// A view of a scene and its chunks for Renderer::traceScene().
+class ChunkedView {
+ public:
+        // An intersected object, and the chunk which holds it, if
+        // any. Holding the chunk prevents it being freed while in
+        // use.
+        class Primitive {
+         public:
+                const Object *object;
+                std::shared_ptr<const Chunk> chunk;
+        };
+
+        inline ChunkedView(const Scene &_scene,
+                           const ChunkCache &_chunks,
+                           const std::vector<const SoftLight *> &_lights,
+                           const size_t _sphereCount)
+                        : scene(_scene), chunks(_chunks), lights(_lights),
+                          sphereCount(_sphereCount) {}
+
+        bool intersect(const Ray &ray,
+                       Scalar *const restrict t,
+                       size_t *const restrict index,
+                       Primitive *const restrict closest) const {
+                // Scratch space, reused between rays.
+                static thread_local std::vector<Crossing> crossings;
+                const Objects &objects = scene.objects;
+                size_t tested = objects.size();
+
+                *t = INFINITY;
+                *index = 0;
+                closest->object = nullptr;
+
+                // Resident objects are numbered after the spheres, as
+                // when a chunked scene is loaded in memory.
+                for (size_t i = 0; i < objects.size(); i++) {
+                        const Scalar current = objects[i]->intersect(ray);
+
+                        if (current != 0 && current < *t) {
+                                *t = current;
+                                *index = sphereCount + i;
+                                closest->object = objects[i];
+                        }
+                }
+
+                // Visit the crossed chunks in order of distance.
+                crossings.clear();
+                for (size_t i = 0; i < chunks.entries.size(); i++) {
+                        Scalar entry;
+                        if (crosses(ray, chunks.entries[i], *t, &entry))
+                                crossings.push_back({entry, i});
+                }
+                std::sort(crossings.begin(), crossings.end(),
+                          [](const Crossing &a, const Crossing &b) {
+                                  return a.entry < b.entry;
+                          });
+
+                for (const auto &crossing : crossings) {
+                        // Spheres lie within their chunk's bounds, so
+                        // no further chunk can hold a closer one.
+                        if (crossing.entry > *t)
+                                break;
+
+                        const auto chunk = chunks.get(crossing.index);
+                        profiling::counters::incChunkVisitCount();
+                        const auto &spheres = chunk->spheres;
+                        const size_t first =
+                                        chunks.entries[crossing.index].first;
+
+                        for (size_t i = 0; i < spheres.size(); i++) {
+                                const Sphere &sphere = spheres[i];
+                                const Scalar current =
+                                                sphere.Sphere::intersect(ray);
+
+                                if (current != 0 && current < *t) {
+                                        *t = current;
+                                        *index = first + i;
+                                        closest->object = &sphere;
+                                        closest->chunk = chunk;
+                                }
+                        }
+                        tested += spheres.size();
+                }
+
+                // Bump profiling counter.
+                profiling::counters::incIntersectionCount(tested);
+
+                return closest->object != nullptr;
+        }
+
+        inline Vector normal(const Primitive &primitive,
+                             const Vector &point) const {
+                return primitive.object->normal(point);
+        }
+
+        inline MaterialIndex surface(const Primitive &primitive,
+                                     const Vector &point) const {
+                return primitive.object->surface(point);
+        }
+
+        inline const Material &material(const MaterialIndex index) const {
+                return scene.materials[index];
+        }
+
+        void shade(Colour *const restrict colour,
+                   const Vector &point,
+                   const Vector &normal,
+                   const Vector &toRay,
+                   const Material *const restrict material,
+                   const size_t maxSamples) const {
+                const auto occluded = [this](const Ray &ray,
+                                             const Scalar distance) {
+                        return this->occluded(ray, distance);
+                };
+
+                for (size_t i = 0; i < scene.lights.size(); i++) {
+                        const SoftLight *const light = lights[i];
+
+                        // Other types of light are only shadowed by
+                        // resident objects.
+                        if (!light) {
+                                *colour += scene.lights[i]->shade(
+                                    point, normal, toRay, material,
+                                    scene.objects, maxSamples);
+                                continue;
+                        }
+
+                        *colour += shadeSoftLight(
+                            light->position, light->colour, light->samples,
+                            &light->sampler, point, normal, toRay, material,
+                            maxSamples, occluded);
+                }
+        }
+
+ private:
+        // Return whether a ray intersects any object within a given
+        // distance.
+        bool occluded(const Ray &ray, const Scalar distance) const {
+                const Objects &objects = scene.objects;
+
+                for (size_t i = 0; i < objects.size(); i++) {
+                        const Scalar t = objects[i]->intersect(ray);
+                        if (t > 0 && t < distance) {
+                                profiling::counters::incIntersectionCount(
+                                    i + 1);
+                                return true;
+                        }
+                }
+
+                size_t tested = objects.size();
+                for (size_t i = 0; i < chunks.entries.size(); i++) {
+                        Scalar entry;
+                        if (!crosses(ray, chunks.entries[i], distance, &entry))
+                                continue;
+
+                        const auto chunk = chunks.get(i);
+                        profiling::counters::incChunkVisitCount();
+                        for (const auto &sphere : chunk->spheres) {
+                                const Scalar t = sphere.Sphere::intersect(ray);
+                                tested++;
+                                if (t > 0 && t < distance) {
+                                        profiling::counters::
+                                                        incIntersectionCount(
+                                                            tested);
+                                        return true;
+                                }
+                        }
+                }
+
+                profiling::counters::incIntersectionCount(tested);
+                return false;
+        }
+
+        const Scene &scene;
+        const ChunkCache &chunks;
+        const std::vector<const SoftLight *> &lights;
+        const size_t sphereCount;
+};
+
+}  // namespace
+
+Scalar ChunkStats::hitRate() const {
+        const uint64_t lookups = hits + misses;
+        return lookups ? static_cast<Scalar>(hits) / lookups : 0;
+}
+
+ChunkCache::ChunkCache(const int _fd,
+                       std::vector<Entry> &&_entries,
+                       const size_t _capacity,
+                       const size_t _materialCount)
+                : entries(std::move(_entries)), capacity(_capacity),
+                  materialCount(_materialCount), fd(_fd),
+                  slots(entries.size()), residentBytes(0) {}
+
+ChunkCache::~ChunkCache() {
+        close(fd);
+}
+
+std::shared_ptr<const Chunk> ChunkCache::get(const size_t index) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        Slot &slot = slots[index];
+
+        if (slot.chunk) {
+                counters.hits++;
+                recent.splice(recent.begin(), recent, slot.recent);
+                return slot.chunk;
+        }
+
+        // Chunks are read while holding the lock, so concurrent
+        // misses are serialised.
+        counters.misses++;
+        const std::shared_ptr<const Chunk> chunk = read(index);
+        const size_t bytes = size(*chunk);
+
+        // Evict the least recently used chunks until the new chunk
+        // fits.
+        while (!recent.empty() && residentBytes + bytes > capacity) {
+                Slot &victim = slots[recent.back()];
+
+                residentBytes -= size(*victim.chunk);
+                victim.chunk.reset();
+                recent.pop_back();
+                counters.evictions++;
+        }
+
+        recent.push_front(index);
+        slot.chunk = chunk;
+        slot.recent = recent.begin();
+        residentBytes += bytes;
+        counters.peakBytes = std::max(counters.peakBytes,
+                                      static_cast<uint64_t>(residentBytes));
+
+        return chunk;
+}
+
+ChunkStats ChunkCache::stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return counters;
+}
+
+std::shared_ptr<const Chunk> ChunkCache::read(const size_t index) const {
+        using sceneformat::SphereRecord;
+
+        const Entry &entry = entries[index];
+        std::vector<SphereRecord> records(entry.count);
+        char *const data = reinterpret_cast<char *>(records.data());
+        const size_t size = entry.count * sizeof(SphereRecord);
+        size_t done = 0;
+
+        while (done < size) {
+                const ssize_t n = pread(fd, data + done, size - done,
+                                        static_cast<off_t>(entry.offset +
+                                                           done));
+                if (n <= 0)
+                        break;
+                done += static_cast<size_t>(n);
+        }
+        counters.bytesRead += done;
+
+        // Spheres which could not be read, or which refer to a
+        // missing material, are rejected.
+        const size_t count = done / sizeof(SphereRecord);
+        auto chunk = std::make_shared<Chunk>();
+        chunk->spheres.reserve(count);
+        counters.rejected += entry.count - count;
+
+        for (size_t i = 0; i < count; i++) {
+                const SphereRecord &record = records[i];
+
+                if (record.material >= materialCount) {
+                        counters.rejected++;
+                        continue;
+                }
+
+                chunk->spheres.emplace_back(
+                    Vector(record.position[0], record.position[1],
+                           record.position[2]),
+                    record.radius,
+                    static_cast<MaterialIndex>(record.material));
+        }
+
+        return chunk;
+}
+
+ChunkedRenderer::ChunkedRenderer(const Scene &_scene,
+                                 const ChunkCache &_chunks,
+                                 const rt::Camera *const restrict _camera,
+                                 const size_t _numDofSamples,
+                                 const size_t _maxRayDepth,
+                                 const Denoiser *const _denoiser)
+                : Renderer(_scene, _camera, _numDofSamples, _maxRayDepth,
+                           _denoiser),
+                  chunks(_chunks), sphereCount(0) {
+        for (const auto light : scene.lights)
+                lights.push_back(dynamic_cast<const SoftLight *>(light));
+        for (const auto &entry : chunks.entries)
+                sphereCount = std::max(sphereCount, static_cast<size_t>(
+                    entry.first + entry.count));
+}
+
+Colour ChunkedRenderer::trace(const Ray &ray,
+                              const Quality &quality,
+                              const unsigned int depth,
+                              Hit *const restrict hit) const {
+        return traceScene(ChunkedView(scene, chunks, lights, sphereCount),
+                          ray, quality, depth, hit);
+}
+
+}  // namespace rt
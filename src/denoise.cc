@@ -0,0 +1,160 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "rt/denoise.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#include "tbb/parallel_for.h"
+
+#include "rt/image.h"
+
+namespace rt {
+
+namespace {
+
+// The 1D B3 spline filter kernel, applied in both dimensions.
+static const std::array<Scalar, 5> kernel = {
+        1. / 16, 1. / 4, 3. / 8, 1. / 4, 1. / 16
+};
+
+// Return the squared distance between two colour samples.
+inline Scalar distance2(const Sample &a, const Sample &b) {
+        const Scalar dr = a.r - b.r;
+        const Scalar dg = a.g - b.g;
+        const Scalar db = a.b - b.b;
+
+        return dr * dr + dg * dg + db * db;
+}
+
+}  // namespace
+
+void Denoiser::denoise(Buffer<Sample> *const restrict image,
+                       Buffer<Sample> *const restrict scratch,
+                       const AuxiliaryBuffers &guides,
+                       const size_t width,
+                       const size_t height) const {
+        scratch->resize(image->size());
+
+        const float *const restrict depth = guides.depth.data();
+        const PackedVector *const restrict normal = guides.normal.data();
+        const Sample *const restrict albedo = guides.albedo.data();
+
+        // Return the edge-stopping weight between two pixels
+        // contributed by their surface geometry and material.
+        const auto surfaceWeight = [=](const size_t p, const size_t q) {
+                const bool missP = !std::isfinite(depth[p]);
+                const bool missQ = !std::isfinite(depth[q]);
+
+                // Pixels which miss every object are only filtered
+                // with other misses.
+                if (missP || missQ)
+                        return missP && missQ ? 1. : 0.;
+
+                const Scalar cosTheta = (normal[p].x * normal[q].x +
+                                         normal[p].y * normal[q].y +
+                                         normal[p].z * normal[q].z);
+                const Scalar wn = std::pow(std::max(cosTheta, 0.),
+                                           normalPower);
+                const Scalar wz = std::exp(-std::fabs(depth[p] - depth[q]) /
+                                           (depthSigma * depth[p]));
+                const Scalar wa = std::exp(-distance2(albedo[p], albedo[q]) /
+                                           (albedoSigma * albedoSigma));
+
+                return wn * wz * wa;
+        };
+
+        Buffer<Sample> *in = image;
+        Buffer<Sample> *out = scratch;
+
+        for (size_t i = 0; i < iterations; i++) {
+                // Filter taps are spaced 2^i pixels apart, and colour
+                // sensitivity increases with each iteration.
+                const size_t step = 1 << i;
+                const Scalar sigma = colourSigma / step;
+                const Scalar colourScale = 1 / (sigma * sigma);
+                const Sample *const restrict src = in->data();
+                Sample *const restrict dst = out->data();
+
+                // Filter rows in parallel.
+                tbb::parallel_for(
+                    static_cast<size_t>(0), height,
+                    [&](const size_t y) {
+                        for (size_t x = 0; x < width; x++) {
+                                const size_t p = image::index(x, y, width);
+                                const Sample centre = src[p];
+                                Scalar r = 0, g = 0, b = 0, weights = 0;
+
+                                for (size_t ky = 0; ky < kernel.size(); ky++) {
+                                        // Skip taps outside of the image.
+                                        const size_t yy = y + ky * step;
+                                        if (yy < 2 * step ||
+                                            yy - 2 * step >= height)
+                                                continue;
+
+                                        for (size_t kx = 0; kx < kernel.size();
+                                             kx++) {
+                                                const size_t xx = x + kx * step;
+                                                if (xx < 2 * step ||
+                                                    xx - 2 * step >= width)
+                                                        continue;
+
+                                                const size_t q = image::index(
+                                                    xx - 2 * step,
+                                                    yy - 2 * step, width);
+                                                const Sample &s = src[q];
+                                                const Scalar w =
+                                                        kernel[kx] * kernel[ky]
+                                                        * std::exp(-distance2(
+                                                            centre, s) *
+                                                                   colourScale)
+                                                        * surfaceWeight(p, q);
+
+                                                r += s.r * w;
+                                                g += s.g * w;
+                                                b += s.b * w;
+                                                weights += w;
+                                        }
+                                }
+
+                                // The centre tap always has a non-zero
+                                // weight for hit pixels; misses have a
+                                // weight of 1 with themselves.
+                                dst[p] = weights > 0 ?
+                                        Sample(Colour(r / weights,
+                                                      g / weights,
+                                                      b / weights)) :
+                                        centre;
+                        }
+                    });
+
+                std::swap(in, out);
+        }
+
+        // Copy the result back to the image, if required.
+        if (in != image)
+                memcpy(image->data(), in->data(),
+                       image->size() * sizeof(Sample));
+}
+
+}  // namespace rt
@@ -0,0 +1,165 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "rt/estimate.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "rt/aov.h"
+#include "rt/image.h"
+#include "rt/lights.h"
+
+namespace rt {
+
+namespace {
+
+// Extend the bounds of a scene's spheres by a box.
+void extend(SceneStats *const stats, const Vector &min, const Vector &max) {
+        const Scalar low[3] = { min.x, min.y, min.z };
+        const Scalar high[3] = { max.x, max.y, max.z };
+        const bool first = !stats->spheres;
+
+        for (size_t i = 0; i < 3; i++) {
+                stats->min[i] = first ? low[i] : std::min(stats->min[i],
+                                                          low[i]);
+                stats->max[i] = first ? high[i] : std::max(stats->max[i],
+                                                           high[i]);
+        }
+}
+
+}  // namespace
+
+SceneStats statistics(const Scene &scene, const ChunkCache *const chunks) {
+        SceneStats stats;
+
+        stats.materials = scene.materials.size();
+
+        // Return whether a material is reflective.
+        const auto reflective = [&](const MaterialIndex index) {
+                const Scalar reflectivity =
+                                scene.materials[index].reflectivity;
+                stats.maxReflectivity = std::max(stats.maxReflectivity,
+                                                 reflectivity);
+                return reflectivity > 0;
+        };
+
+        for (const auto object : scene.objects) {
+                // Test for checkerboards first, since they are planes.
+                if (auto board = dynamic_cast<const CheckerBoard *>(object)) {
+                        const bool reflects = reflective(board->material1);
+                        if (reflective(board->material2) || reflects)
+                                stats.mirrors++;
+                        stats.checkerBoards++;
+                } else if (auto plane = dynamic_cast<const Plane *>(object)) {
+                        if (reflective(plane->material))
+                                stats.mirrors++;
+                        stats.planes++;
+                } else if (auto sphere = dynamic_cast<const Sphere *>(object)) {
+                        const Vector radius(sphere->radius, sphere->radius,
+                                            sphere->radius);
+                        extend(&stats, sphere->position - radius,
+                               sphere->position + radius);
+                        if (reflective(sphere->material))
+                                stats.mirrors++;
+                        stats.spheres++;
+                } else {
+                        stats.otherObjects++;
+                }
+        }
+
+        // Chunked spheres are counted from their bounds, without
+        // loading them.
+        if (chunks) {
+                for (const auto &entry : chunks->entries) {
+                        extend(&stats, entry.min, entry.max);
+                        stats.spheres += entry.count;
+                }
+        }
+
+        for (const auto light : scene.lights) {
+                auto soft = dynamic_cast<const SoftLight *>(light);
+                stats.lightSamples += soft ? soft->samples : 1;
+                stats.lights++;
+        }
+
+        return stats;
+}
+
+Estimate estimate(const Renderer &renderer,
+                  const size_t width,
+                  const size_t height,
+                  const size_t count) {
+        Estimate result;
+
+        result.pixels = width * height;
+        result.sampled = std::min(count, result.pixels);
+        if (!result.sampled)
+                return result;
+
+        // Totals over the sampled pixels.
+        size_t samples = 0;
+        profiling::Counter traces = 0, shadowRays = 0, intersections = 0;
+        Scalar seconds = 0;
+
+        for (size_t i = 0; i < result.sampled; i++) {
+                // Spread the sampled pixels evenly over the image.
+                const size_t index = (2 * i + 1) * result.pixels /
+                                (2 * result.sampled);
+                Cost start;
+
+                samples += renderer.samplePixel(image::x(index, width),
+                                                image::y(index, width),
+                                                width, height, &start);
+
+                const Cost end;
+                traces += end.traces - start.traces;
+                shadowRays += end.shadowRays - start.shadowRays;
+                intersections += end.intersections - start.intersections;
+                seconds += std::chrono::duration<Scalar>(
+                    end.time - start.time).count();
+        }
+
+        const auto n = static_cast<Scalar>(result.sampled);
+        const auto pixels = static_cast<Scalar>(result.pixels);
+        result.sampleSeconds = seconds;
+        result.samplesPerPixel = static_cast<Scalar>(samples) / n;
+        result.seconds = seconds / n * pixels;
+
+        // Without instrumentation there are no counts to extrapolate.
+        if (!profiling::instrumentation)
+                return result;
+
+        result.tracesPerPixel = static_cast<Scalar>(traces) / n;
+        result.shadowRaysPerPixel = static_cast<Scalar>(shadowRays) / n;
+        result.intersectionsPerPixel = static_cast<Scalar>(intersections) / n;
+
+        // Each sampled point casts one camera ray per lens sample.
+        const Scalar cameraRays = static_cast<Scalar>(samples) *
+                        static_cast<Scalar>(renderer.numDofSamples);
+        result.reflectionDepth = static_cast<Scalar>(traces) / cameraRays - 1;
+
+        result.traces = result.tracesPerPixel * pixels;
+        result.shadowRays = result.shadowRaysPerPixel * pixels;
+        result.intersections = result.intersectionsPerPixel * pixels;
+
+        return result;
+}
+
+}  // namespace rt
@@ -0,0 +1,148 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "rt/image.h"
+
+#include <string>
+
+namespace rt {
+
+DynamicImage::DynamicImage(const size_t _width,
+                           const size_t _height,
+                           const Scalar _saturation,
+                           const Colour _gamma,
+                           const bool _inverted)
+                : data(_width * _height),
+                  width(_width),
+                  height(_height),
+                  size(_width * _height),
+                  saturation(_saturation),
+                  gamma(Colour(1 / _gamma.r,
+                               1 / _gamma.g,
+                               1 / _gamma.b)),
+                  inverted(_inverted) {}
+
+namespace image {
+
+namespace {
+
+// Read the next whitespace separated integer from a PPM header,
+// skipping any "#" comments. Returns false on error.
+bool readHeaderValue(std::istream &in, size_t *const restrict value) {
+        in >> std::ws;
+        while (in.peek() == '#') {
+                std::string comment;
+                std::getline(in, comment);
+                in >> std::ws;
+        }
+
+        return static_cast<bool>(in >> *value);
+}
+
+}  // namespace
+
+std::string outputPath(const std::string &path, const std::string &name) {
+        const std::string extension = ".ppm";
+        std::string stem = path;
+
+        if (stem.size() > extension.size() &&
+            !stem.compare(stem.size() - extension.size(),
+                          extension.size(), extension))
+                stem.erase(stem.size() - extension.size());
+
+        return stem + "." + name + extension;
+}
+
+void writePPM(std::ostream &out,
+              const Pixel *const restrict data,
+              const size_t width,
+              const size_t height) {
+        // Print PPM header.
+
+        // Magic number:
+        out << "P3" << std::endl;
+        // Image dimensions:
+        out << width << " " << height << std::endl;
+        // Max colour value:
+        out << unsigned(Pixel::ComponentMax) << std::endl;
+
+        // Iterate over each point in the image, writing pixel data.
+        const size_t size = width * height;
+        for (size_t i = 0; i < size; i++) {
+                out << data[i] << " ";
+
+                // Add newline at the end of each row:
+                if (!((i + 1) % width))
+                        out << std::endl;
+        }
+}
+
+DynamicImage *readPPM(std::istream &in) {
+        std::string magic;
+        size_t width, height, max;
+
+        // Read PPM header.
+        in >> magic;
+        if (magic != "P3" && magic != "P6")
+                return nullptr;
+        if (!readHeaderValue(in, &width) ||
+            !readHeaderValue(in, &height) ||
+            !readHeaderValue(in, &max))
+                return nullptr;
+        if (!width || !height || !max || max > 255)
+                return nullptr;
+
+        DynamicImage *const image = new DynamicImage(width, height);
+
+        // Rescale components to the range [0,Pixel::ComponentMax].
+        const auto component = [max](const size_t value) {
+                return static_cast<Pixel::Component>(
+                    value * Pixel::ComponentMax / max);
+        };
+
+        if (magic == "P3") {
+                for (auto &pixel : image->data) {
+                        size_t r, g, b;
+                        if (!(in >> r >> g >> b)) {
+                                delete image;
+                                return nullptr;
+                        }
+                        pixel = {component(r), component(g), component(b)};
+                }
+        } else {
+                // A single whitespace character separates the header
+                // from the raw pixel data.
+                in.get();
+                for (auto &pixel : image->data) {
+                        unsigned char rgb[3];
+                        if (!in.read(reinterpret_cast<char *>(rgb), 3)) {
+                                delete image;
+                                return nullptr;
+                        }
+                        pixel = {component(rgb[0]), component(rgb[1]),
+                                 component(rgb[2])};
+                }
+        }
+
+        return image;
+}
+
+}  // namespace image
+
+}  // namespace rt
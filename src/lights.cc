@@ -33,11 +33,14 @@ bool intersects(const Ray &ray,
     // Determine any object intersects ray within distance:
     for (size_t i = 0; i < objects.size(); i++) {
         const Scalar t = objects[i]->intersect(ray);
-        if (t > 0 && t < distance)
+        if (t > 0 && t < distance) {
+            profiling::counters::incIntersectionCount(i + 1);
             return true;
+        }
     }
 
     // No intersect.
+    profiling::counters::incIntersectionCount(objects.size());
     return false;
 }
 
@@ -47,51 +50,14 @@ Colour SoftLight::shade(const Vector &point,
                         const Vector &normal,
                         const Vector &toRay,
                         const Material *const restrict material,
-                        const Objects objects) const {
-        // Shading is additive, starting with black.
-        Colour output = Colour();
-
-        // Product of material and light colour.
-        const Colour illumination = (colour * material->colour) / samples;
-
-        // Cast multiple light rays, nomrally distributed about the
-        // light's centre.
-        for (size_t i = 0; i < samples; i++) {
-                // Create a new point origin randomly offset from centre.
-                const Vector origin = Vector(position.x + sampler(),
-                                             position.y + sampler(),
-                                             position.z + sampler());
-                // Vector from point to light.
-                const Vector toLight = origin - point;
-                // Distance from point to light.
-                const Scalar distance = toLight.size();
-                // Direction from point to light.
-                const Vector direction = toLight / distance;
-
-                // Determine whether light is blocked.
-                const bool blocked = intersects(Ray(point, direction),
-                                                objects, distance);
-                // Do nothing without line of sight.
-                if (blocked)
-                        continue;
-
-                // Bump the profiling counter.
-                profiling::counters::incRayCount();
-
-                // Apply Lambert (diffuse) shading.
-                const Scalar lambert = std::max(normal ^ direction,
-                                                static_cast<Scalar>(0));
-                output += illumination * material->diffuse * lambert;
-
-                // Apply Blinn-Phong (specular) shading.
-                const Vector bisector = (toRay + direction).normalise();
-                const Scalar phong = pow(std::max(normal ^ bisector,
-                                                  static_cast<Scalar>(0)),
-                                         material->shininess);
-                output += illumination * material->specular * phong;
-        }
-
-        return output;
+                        const Objects objects,
+                        const size_t maxSamples) const {
+        return shadeSoftLight(position, colour, samples, &sampler, point,
+                              normal, toRay, material, maxSamples,
+                              [&](const Ray &ray, const Scalar distance) {
+                                      return intersects(ray, objects,
+                                                        distance);
+                              });
 }
 
 
@@ -19,8 +19,41 @@
  */
 #include "rt/objects.h"
 
+#include <utility>
+
 namespace rt {
 
+Materials::Materials() : data(nullptr), count(0) {}
+
+Materials::Materials(const Material *const _data, const size_t _size)
+                : data(_data), count(_size) {}
+
+Materials::Materials(Materials &&other)
+                : owned(std::move(other.owned)),
+                  indices(std::move(other.indices)),
+                  data(other.data), count(other.count) {
+        other.data = nullptr;
+        other.count = 0;
+}
+
+MaterialIndex Materials::add(const Material &material) {
+        const Key key = {{
+                material.colour.r, material.colour.g, material.colour.b,
+                material.ambient, material.diffuse, material.specular,
+                material.shininess, material.reflectivity
+        }};
+
+        const auto it = indices.find(key);
+        if (it != indices.end())
+                return it->second;
+
+        owned.push_back(material);
+        data = owned.data();
+        count = owned.size();
+
+        return indices[key] = static_cast<MaterialIndex>(count - 1);
+}
+
 const Scalar CheckerBoard::gridOffset = 3e6;
 
 }  // namespace rt
@@ -0,0 +1,55 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "rt/options.h"
+
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+
+namespace rt {
+
+namespace options {
+
+uint64_t count(const char *const option, const char *const value,
+               const bool allowZero) {
+        // strtoull() skips leading whitespace and accepts a sign, so
+        // check that the first non-space character is a digit.
+        const char *digits = value;
+        while (isspace(static_cast<unsigned char>(*digits)))
+                digits++;
+
+        char *end;
+        errno = 0;
+        const unsigned long long n = strtoull(digits, &end, 10);
+
+        if (!isdigit(static_cast<unsigned char>(*digits)) || *end ||
+            errno == ERANGE || (!n && !allowZero)) {
+                fprintf(stderr, "fatal: invalid value '%s' for %s\n",
+                        value, option);
+                exit(1);
+        }
+
+        return n;
+}
+
+}  // namespace options
+
+}  // namespace rt
@@ -0,0 +1,155 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "rt/perf.h"
+
+#ifdef __linux__
+# include <linux/perf_event.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstring>
+
+namespace rt {
+
+namespace profiling {
+
+HardwareCounts &HardwareCounts::operator+=(const HardwareCounts &other) {
+        cycles += other.cycles;
+        instructions += other.instructions;
+        cacheMisses += other.cacheMisses;
+        branchMisses += other.branchMisses;
+        return *this;
+}
+
+HardwareCounts HardwareCounts::operator-(const HardwareCounts &other) const {
+        HardwareCounts difference;
+        difference.cycles = cycles - other.cycles;
+        difference.instructions = instructions - other.instructions;
+        difference.cacheMisses = cacheMisses - other.cacheMisses;
+        difference.branchMisses = branchMisses - other.branchMisses;
+        return difference;
+}
+
+double HardwareCounts::ipc() const {
+        return cycles ? static_cast<double>(instructions) / cycles : 0;
+}
+
+constexpr size_t HardwareCounters::numEvents;
+
+#ifdef __linux__
+
+namespace {
+
+// The events to count, in the order of the HardwareCounts members.
+const uint64_t events[] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES
+};
+
+// Open a counter for a hardware event in user space, of the calling
+// thread and its future children. Returns -1 on error.
+int openCounter(const uint64_t event) {
+        struct perf_event_attr attr;
+
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = event;
+        attr.read_format = (PERF_FORMAT_TOTAL_TIME_ENABLED |
+                            PERF_FORMAT_TOTAL_TIME_RUNNING);
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1,
+                                        -1, 0));
+}
+
+// Read a counter, scaled for the time it was scheduled.
+uint64_t readCounter(const int fd) {
+        uint64_t values[3];  // Value, time enabled, time running.
+
+        if (fd < 0 || ::read(fd, values, sizeof(values)) !=
+            static_cast<ssize_t>(sizeof(values)) || !values[2])
+                return 0;
+
+        if (values[2] == values[1])
+                return values[0];
+        return static_cast<uint64_t>(static_cast<double>(values[0]) *
+                                     values[1] / values[2]);
+}
+
+}  // namespace
+
+HardwareCounters::HardwareCounters() : opened(0) {
+        for (size_t i = 0; i < numEvents; i++) {
+                fds[i] = openCounter(events[i]);
+                if (fds[i] >= 0)
+                        opened++;
+                else if (reason.empty())
+                        reason = std::string("perf_event_open: ") +
+                                        strerror(errno);
+        }
+
+        if (opened)
+                reason.clear();
+}
+
+HardwareCounters::~HardwareCounters() {
+        for (const int fd : fds)
+                if (fd >= 0)
+                        close(fd);
+}
+
+HardwareCounts HardwareCounters::read() const {
+        HardwareCounts counts;
+
+        counts.cycles = readCounter(fds[0]);
+        counts.instructions = readCounter(fds[1]);
+        counts.cacheMisses = readCounter(fds[2]);
+        counts.branchMisses = readCounter(fds[3]);
+
+        return counts;
+}
+
+#else  // __linux__
+
+HardwareCounters::HardwareCounters()
+                : opened(0),
+                  reason("hardware counters are only supported on Linux") {
+        for (size_t i = 0; i < numEvents; i++)
+                fds[i] = -1;
+}
+
+HardwareCounters::~HardwareCounters() {}
+
+HardwareCounts HardwareCounters::read() const {
+        return HardwareCounts();
+}
+
+#endif  // __linux__
+
+}  // namespace profiling
+
+}  // namespace rt
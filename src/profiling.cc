@@ -19,16 +19,206 @@
  */
 #include "rt/profiling.h"
 
+#include <algorithm>
+
+#include "tbb/task_arena.h"
+
+#include "rt/timeline.h"
+
 namespace rt {
 
 namespace profiling {
 
+constexpr size_t Histogram::size;
+
+void Histogram::clear() {
+        buckets.fill(0);
+        count = sum = max = 0;
+}
+
+Histogram &Histogram::operator+=(const Histogram &other) {
+        for (size_t i = 0; i < size; i++)
+                buckets[i] += other.buckets[i];
+        count += other.count;
+        sum += other.sum;
+        max = std::max(max, other.max);
+        return *this;
+}
+
+void Counts::clear() {
+        traces = rays = shadowRays = intersections = 0;
+        reflections = shadowIntersections = chunkVisits = 0;
+        lit = penumbra = umbra = 0;
+        reflectionDepth.clear();
+        traceTests.clear();
+        shadowTests.clear();
+        shadowRaysPerPoint.clear();
+        supersampleDepth.clear();
+        busy = 0;
+}
+
+Counts &Counts::operator+=(const Counts &other) {
+        traces += other.traces;
+        rays += other.rays;
+        shadowRays += other.shadowRays;
+        intersections += other.intersections;
+        reflections += other.reflections;
+        shadowIntersections += other.shadowIntersections;
+        chunkVisits += other.chunkVisits;
+        lit += other.lit;
+        penumbra += other.penumbra;
+        umbra += other.umbra;
+        reflectionDepth += other.reflectionDepth;
+        traceTests += other.traceTests;
+        shadowTests += other.shadowTests;
+        shadowRaysPerPoint += other.shadowRaysPerPoint;
+        supersampleDepth += other.supersampleDepth;
+        busy += other.busy;
+        return *this;
+}
+
+Counts Statistics::totals() const {
+        Counts sum;
+        for (const auto &shard : shards)
+                sum += shard;
+        return sum;
+}
+
+Counter Statistics::total(Counter Counts::*const count) const {
+        Counter sum = 0;
+        for (const auto &shard : shards)
+                sum += shard.*count;
+        return sum;
+}
+
+void Statistics::reset() {
+        for (auto &shard : shards)
+                shard.clear();
+}
+
+// Return the nanoseconds elapsed since a time.
+static Counter nanoseconds(const std::chrono::steady_clock::time_point start) {
+        return static_cast<Counter>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count());
+}
+
+#if RT_INSTRUMENTATION >= 1
+
+// The counts of threads outside of any scope.
+static thread_local Counts unscoped;
+// The counts of the calling thread's current scope.
+static thread_local Counts *current = &unscoped;
+
+Scope::Scope(Statistics *const statistics) : previous(current) {
+        current = &statistics->local();
+}
+
+Scope::~Scope() {
+        current = previous;
+}
+
+BusyTimer::~BusyTimer() {
+        current->busy += nanoseconds(start);
+}
+
+#endif  // RT_INSTRUMENTATION >= 1
+
+Scalar Phases::Node::utilisation() const {
+        return threads && seconds > 0 ? busy / (seconds * threads) : 0;
+}
+
+constexpr size_t Phases::none;
+
+std::vector<size_t> Phases::children(const size_t node) const {
+        std::vector<size_t> indices;
+
+        for (size_t i = 0; i < tree.size(); i++)
+                if (tree[i].parent == node)
+                        indices.push_back(i);
+
+        return indices;
+}
+
+// The calling thread's recording.
+static thread_local Phases *recording = nullptr;
+
+Phases *Phases::current() {
+        return recording;
+}
+
+Recording::Recording(Phases *const phases) : previous(recording) {
+        recording = phases;
+}
+
+Recording::~Recording() {
+        recording = previous;
+}
+
+Phase::Phase(const char *const _name, const Statistics *const _statistics)
+                : phases(recording), timeline(Timeline::active()),
+                  statistics(instrumentation ? _statistics : nullptr),
+                  name(_name), node(0),
+                  busy(statistics ? statistics->busy() : 0),
+                  start(std::chrono::steady_clock::now()) {
+        if (!phases)
+                return;
+
+        std::vector<Phases::Node> &tree = phases->tree;
+
+        // Find or create the node for the phase.
+        for (node = 0; node < tree.size(); node++)
+                if (tree[node].parent == phases->open &&
+                    tree[node].name == name)
+                        break;
+        if (node == tree.size())
+                tree.push_back({name, phases->open, 0, 0, 0, 0, {}});
+
+        tree[node].calls++;
+        phases->open = node;
+
+        if (phases->hardware && phases->hardware->available())
+                hardware = phases->hardware->read();
+}
+
+Phase::~Phase() {
+        end();
+}
+
+void Phase::end() {
+        if (!name)
+                return;
+
+        // Record a span for the phase on the active timeline.
+        if (timeline)
+                timeline->record(name, start,
+                                 std::chrono::steady_clock::now());
+
+        name = nullptr;
+        if (!phases)
+                return;
+
+        Phases::Node &phase = phases->tree[node];
+        phase.seconds += nanoseconds(start) / 1e9;
+        if (statistics) {
+                phase.busy += (statistics->busy() - busy) / 1e9;
+                phase.threads = static_cast<size_t>(
+                    tbb::this_task_arena::max_concurrency());
+        }
+
+        if (phases->hardware && phases->hardware->available())
+                phase.hardware += phases->hardware->read() - hardware;
+
+        phases->open = phase.parent;
+        phases = nullptr;
+}
+
 namespace counters {
 
+#if RT_INSTRUMENTATION >= 1
+
 static std::atomic<Counter> objectsCount;
 static std::atomic<Counter> lightsCount;
-static std::atomic<Counter> traceCounter;
-static std::atomic<Counter> rayCounter;
 
 void incObjectsCount(const size_t n) {
     objectsCount += n;
@@ -47,21 +237,84 @@ Counter getLightsCount() {
 }
 
 void incTraceCount(const size_t n) {
-    traceCounter += n;
+    current->traces += n;
 }
 
-Counter getTraceCount() {
-    return static_cast<Counter>(traceCounter);
+Counter getThreadTraceCount() {
+    return current->traces;
 }
 
 void incRayCount(const size_t n) {
-    rayCounter += n;
+    current->rays += n;
+}
+
+Counter getThreadRayCount() {
+    return current->rays;
+}
+
+void incShadowRayCount(const size_t n) {
+    current->shadowRays += n;
+}
+
+Counter getThreadShadowRayCount() {
+    return current->shadowRays;
+}
+
+void incIntersectionCount(const size_t n) {
+    current->intersections += n;
+}
+
+Counter getThreadIntersectionCount() {
+    return current->intersections;
+}
+
+#endif  // RT_INSTRUMENTATION >= 1
+
+#if RT_INSTRUMENTATION >= 2
+
+void incReflectionCount(const size_t n) {
+    current->reflections += n;
+}
+
+void incShadowIntersectionCount(const size_t n) {
+    current->shadowIntersections += n;
+}
+
+void incChunkVisitCount(const size_t n) {
+    current->chunkVisits += n;
 }
 
-Counter getRayCount() {
-    return static_cast<Counter>(rayCounter);
+void addReflectionDepth(const size_t depth) {
+    current->reflectionDepth.add(depth);
 }
 
+void addTraceTests(const Counter tests) {
+    current->traceTests.add(tests);
+}
+
+void addShadowTests(const Counter tests) {
+    current->shadowTests.add(tests);
+}
+
+void addShadowRaysPerPoint(const Counter rays) {
+    current->shadowRaysPerPoint.add(rays);
+}
+
+void addSupersampleDepth(const size_t depth) {
+    current->supersampleDepth.add(depth);
+}
+
+void addLightSampling(const size_t samples, const size_t blocked) {
+    if (!blocked)
+        current->lit++;
+    else if (blocked < samples)
+        current->penumbra++;
+    else
+        current->umbra++;
+}
+
+#endif  // RT_INSTRUMENTATION >= 2
+
 }  // namespace counters
 
 }  // namespace profiling
@@ -0,0 +1,204 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "rt/progress.h"
+
+#include <algorithm>
+
+#include "tbb/task_arena.h"
+
+namespace rt {
+
+namespace profiling {
+
+// The active progress monitor, if any.
+static std::atomic<Progress *> activeProgress(nullptr);
+
+// Return the seconds between two times.
+static Scalar seconds(const Progress::Time start, const Progress::Time end) {
+        return std::chrono::duration<Scalar>(end - start).count();
+}
+
+Progress::Progress(const Scalar _interval, FILE *const _out)
+                : interval(_interval), out(_out),
+                  numSlots(static_cast<size_t>(
+                      tbb::this_task_arena::max_concurrency())),
+                  slots(new Slot[numSlots]), units(0), tiles(0),
+                  name(nullptr), total(0), index(0), passes(0),
+                  epoch(std::chrono::steady_clock::now()),
+                  passStart(epoch), lastReport(epoch), lastRays(0),
+                  stopping(false) {
+        for (size_t i = 0; i < numSlots; i++)
+                slots[i].busy = slots[i].rays = 0;
+}
+
+Progress::~Progress() {
+        stop();
+        delete[] slots;
+}
+
+void Progress::begin(const char *const _name,
+                     const size_t _units,
+                     const size_t _index,
+                     const size_t _passes) {
+        Progress *const progress = active();
+        if (!progress)
+                return;
+
+        std::lock_guard<std::mutex> lock(progress->mutex);
+        progress->name = _name;
+        progress->total = _units;
+        progress->index = _index;
+        progress->passes = _passes;
+        progress->units = 0;
+        progress->passStart = std::chrono::steady_clock::now();
+}
+
+void Progress::finish() {
+        Progress *const progress = active();
+        if (!progress)
+                return;
+
+        std::lock_guard<std::mutex> lock(progress->mutex);
+        if (progress->name)
+                progress->report(true);
+        progress->name = nullptr;
+}
+
+void Progress::advance(const size_t _units,
+                       const Counter nanoseconds,
+                       const Counter rays) {
+        // Threads outside of the arena share slots.
+        const int threadIndex = tbb::this_task_arena::current_thread_index();
+        Slot &slot = slots[threadIndex >= 0 ?
+                           static_cast<size_t>(threadIndex) % numSlots : 0];
+
+        slot.busy.fetch_add(nanoseconds, std::memory_order_relaxed);
+        slot.rays.fetch_add(rays, std::memory_order_relaxed);
+        units.fetch_add(_units, std::memory_order_relaxed);
+        tiles.fetch_add(1, std::memory_order_relaxed);
+}
+
+Progress *Progress::active() {
+        return activeProgress.load(std::memory_order_relaxed);
+}
+
+void Progress::start() {
+        stopping = false;
+        thread = std::thread([this]() {
+                std::unique_lock<std::mutex> lock(mutex);
+                while (!wake.wait_for(lock, interval,
+                                      [this]() { return stopping; })) {
+                        if (name)
+                                report(false);
+                }
+        });
+}
+
+void Progress::stop() {
+        if (!thread.joinable())
+                return;
+
+        {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+}
+
+void Progress::report(const bool passDone) {
+        const Time now = std::chrono::steady_clock::now();
+
+        // Fraction of the current pass done.
+        const Scalar fraction = passDone || !total ? 1 :
+                        std::min(static_cast<Scalar>(units) / total,
+                                 static_cast<Scalar>(1));
+        const Scalar percent = 100 * (index + fraction) /
+                        std::max(passes, static_cast<size_t>(1));
+
+        Counter rays = 0;
+        for (size_t i = 0; i < numSlots; i++)
+                rays += slots[i].rays.load(std::memory_order_relaxed);
+        const Scalar period = seconds(lastReport, now);
+        const Scalar rate = period > 0 ? (rays - lastRays) / period : 0;
+        lastReport = now;
+        lastRays = rays;
+
+        fprintf(out, "{\"progress\": {\"pass\": \"%s\", \"passIndex\": %lu, "
+                "\"passes\": %lu, \"percent\": %.2f, \"tiles\": %lu, "
+                "\"raysPerSecond\": %.0f, \"elapsedSeconds\": %.3f, "
+                "\"passRemainingSeconds\": ", name, index, passes, percent,
+                tiles.load(), rate, seconds(epoch, now));
+        if (fraction > 0)
+                fprintf(out, "%.3f", seconds(passStart, now) *
+                        (1 - fraction) / fraction);
+        else
+                fprintf(out, "null");
+
+        fprintf(out, ", \"threadBusySeconds\": [");
+        for (size_t i = 0; i < numSlots; i++)
+                fprintf(out, "%s%.3f", i ? ", " : "",
+                        slots[i].busy.load(std::memory_order_relaxed) / 1e9);
+        fprintf(out, "], \"done\": %s}}\n",
+                passDone && index + 1 >= passes ? "true" : "false");
+        fflush(out);
+}
+
+Monitoring::Monitoring(Progress *const _progress)
+                : progress(_progress),
+                  previous(_progress ? activeProgress.exchange(_progress) :
+                           nullptr) {
+        if (progress)
+                progress->start();
+}
+
+Monitoring::~Monitoring() {
+        if (!progress)
+                return;
+
+        progress->stop();
+        activeProgress = previous;
+}
+
+Work::Work(const size_t _units)
+                : progress(Progress::active()), units(_units), rays(0) {
+        if (!progress)
+                return;
+
+        rays = counters::getThreadRayCount();
+        start = std::chrono::steady_clock::now();
+}
+
+Work::~Work() {
+        if (!progress)
+                return;
+
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        const Counter nanoseconds = static_cast<Counter>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                elapsed).count());
+
+        progress->advance(units, nanoseconds,
+                          counters::getThreadRayCount() - rays);
+}
+
+}  // namespace profiling
+
+}  // namespace rt
@@ -0,0 +1,208 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "rt/quality.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace rt {
+
+namespace quality {
+
+namespace {
+
+// SSIM stabilisation constants, for a dynamic range of 1.
+static const Scalar ssimC1 = 0.01 * 0.01;
+static const Scalar ssimC2 = 0.03 * 0.03;
+
+// SSIM gaussian window radius and standard deviation.
+static const size_t ssimRadius = 5;
+static const Scalar ssimSigma = 1.5;
+
+// Return a pixel component in the range [0,1].
+inline Scalar component(const Pixel::Component c) {
+        return static_cast<Scalar>(c) / Pixel::ComponentMax;
+}
+
+// Return the relative luminance of a pixel, in the range [0,1].
+inline Scalar luminance(const Pixel &p) {
+        return (0.2126 * component(p.r) +
+                0.7152 * component(p.g) +
+                0.0722 * component(p.b));
+}
+
+// Return the largest absolute component difference between two
+// pixels, in the range [0,1].
+inline Scalar pixelError(const Pixel &a, const Pixel &b) {
+        return std::max(std::fabs(component(a.r) - component(b.r)),
+                        std::max(std::fabs(component(a.g) - component(b.g)),
+                                 std::fabs(component(a.b) - component(b.b))));
+}
+
+// Return the index of the k-th kernel sample about i, along an axis of
+// length n. Samples outside of the axis are clamped to the border.
+inline size_t offset(const size_t i, const size_t k, const size_t n) {
+        const size_t j = i + k;
+        return j < ssimRadius ? 0 : std::min(j - ssimRadius, n - 1);
+}
+
+// Blur a single channel image using a separable, normalised gaussian
+// kernel. Samples outside of the image are clamped to the border.
+std::vector<Scalar> blur(const std::vector<Scalar> &in,
+                         const std::vector<Scalar> &kernel,
+                         const size_t width,
+                         const size_t height) {
+        std::vector<Scalar> tmp(in.size()), out(in.size());
+
+        // Horizontal pass.
+        for (size_t y = 0; y < height; y++) {
+                for (size_t x = 0; x < width; x++) {
+                        Scalar sum = 0;
+                        for (size_t k = 0; k < kernel.size(); k++) {
+                                const size_t xx = offset(x, k, width);
+                                sum += kernel[k] * in[y * width + xx];
+                        }
+                        tmp[y * width + x] = sum;
+                }
+        }
+
+        // Vertical pass.
+        for (size_t y = 0; y < height; y++) {
+                for (size_t x = 0; x < width; x++) {
+                        Scalar sum = 0;
+                        for (size_t k = 0; k < kernel.size(); k++) {
+                                const size_t yy = offset(y, k, height);
+                                sum += kernel[k] * tmp[yy * width + x];
+                        }
+                        out[y * width + x] = sum;
+                }
+        }
+
+        return out;
+}
+
+}  // namespace
+
+Scalar mse(const DynamicImage &reference, const DynamicImage &image) {
+        Scalar sum = 0;
+
+        for (size_t i = 0; i < reference.size; i++) {
+                const Pixel &a = reference.data[i];
+                const Pixel &b = image.data[i];
+                const Scalar dr = component(a.r) - component(b.r);
+                const Scalar dg = component(a.g) - component(b.g);
+                const Scalar db = component(a.b) - component(b.b);
+
+                sum += dr * dr + dg * dg + db * db;
+        }
+
+        return sum / (3 * reference.size);
+}
+
+Scalar psnr(const DynamicImage &reference, const DynamicImage &image) {
+        const Scalar error = mse(reference, image);
+
+        if (error == 0)
+                return INFINITY;
+
+        // Peak signal value is 1, so PSNR = 10 log10(1 / MSE).
+        return -10 * std::log10(error);
+}
+
+Scalar ssim(const DynamicImage &reference, const DynamicImage &image) {
+        const size_t size = reference.size;
+
+        // Create a normalised gaussian kernel.
+        std::vector<Scalar> kernel(2 * ssimRadius + 1);
+        Scalar kernelSum = 0;
+        for (size_t i = 0; i < kernel.size(); i++) {
+                const Scalar k = static_cast<Scalar>(i) -
+                                 static_cast<Scalar>(ssimRadius);
+                kernel[i] = std::exp(-(k * k) / (2 * ssimSigma * ssimSigma));
+                kernelSum += kernel[i];
+        }
+        for (auto &k : kernel)
+                k /= kernelSum;
+
+        // Luminance channels, their squares and product.
+        std::vector<Scalar> x(size), y(size), xx(size), yy(size), xy(size);
+        for (size_t i = 0; i < size; i++) {
+                x[i] = luminance(reference.data[i]);
+                y[i] = luminance(image.data[i]);
+                xx[i] = x[i] * x[i];
+                yy[i] = y[i] * y[i];
+                xy[i] = x[i] * y[i];
+        }
+
+        // Local (windowed) means and moments.
+        const size_t w = reference.width, h = reference.height;
+        const auto muX = blur(x, kernel, w, h);
+        const auto muY = blur(y, kernel, w, h);
+        const auto sigmaXX = blur(xx, kernel, w, h);
+        const auto sigmaYY = blur(yy, kernel, w, h);
+        const auto sigmaXY = blur(xy, kernel, w, h);
+
+        // Average the SSIM index over every window.
+        Scalar sum = 0;
+        for (size_t i = 0; i < size; i++) {
+                const Scalar mx = muX[i], my = muY[i];
+                const Scalar vx = sigmaXX[i] - mx * mx;
+                const Scalar vy = sigmaYY[i] - my * my;
+                const Scalar cov = sigmaXY[i] - mx * my;
+
+                sum += (((2 * mx * my + ssimC1) * (2 * cov + ssimC2)) /
+                        ((mx * mx + my * my + ssimC1) * (vx + vy + ssimC2)));
+        }
+
+        return sum / size;
+}
+
+Comparison compare(const DynamicImage &reference, const DynamicImage &image) {
+        Comparison result;
+
+        result.mse = mse(reference, image);
+        result.psnr = result.mse ? -10 * std::log10(result.mse) : INFINITY;
+        result.ssim = ssim(reference, image);
+        result.maxError = 0;
+        for (size_t i = 0; i < reference.size; i++)
+                result.maxError = std::max(result.maxError,
+                                           pixelError(reference.data[i],
+                                                      image.data[i]));
+
+        return result;
+}
+
+void errorMap(const DynamicImage &reference,
+              const DynamicImage &image,
+              DynamicImage *const out,
+              const Scalar scale) {
+        // Write directly to the pixel data, since the input images
+        // have already had any Y axis inversion applied.
+        for (size_t i = 0; i < reference.size; i++) {
+                const Scalar error = pixelError(reference.data[i],
+                                                image.data[i]);
+                out->data[i] = static_cast<Pixel>(heat(error * scale));
+        }
+}
+
+}  // namespace quality
+
+}  // namespace rt
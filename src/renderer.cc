@@ -19,7 +19,9 @@
  */
 #include "rt/renderer.h"
 
+#include <algorithm>
 #include <array>
+#include <limits>
 
 #include "rt/debug.h"
 #include "rt/profiling.h"
@@ -30,14 +32,16 @@ namespace {
 using namespace rt;  // NOLINT(build/namespaces)
 
 // Return the object with the closest intersection to ray, and set the
-// distance to the intersection `t'. If no intersection, returns a
-// nullptr.
+// distance to the intersection `t' and the object's index. If no
+// intersection, returns a nullptr.
 static inline auto closestIntersect(const Ray &ray,
                                     const Objects &objects,
-                                    Scalar *const restrict t) {
+                                    Scalar *const restrict t,
+                                    size_t *const restrict index) {
         // Index of, and distance to closest intersect:
         const Object *closest = nullptr;
         *t = INFINITY;
+        *index = 0;
 
         // For each object:
         for (size_t i = 0; i < objects.size(); i++) {
@@ -49,32 +53,189 @@ static inline auto closestIntersect(const Ray &ray,
                 if (currentT != 0 && currentT < *t) {
                         // New closest intersection.
                         *t = currentT;
+                        *index = i;
                         closest = objects[i];
                 }
         }
 
+        // Bump profiling counter.
+        profiling::counters::incIntersectionCount(objects.size());
+
         return closest;
 }
 
+// A view of a scene for Renderer::traceScene(), which dispatches to
+// the scene's objects and lights through their virtual methods.
+class SceneView {
+ public:
+        typedef const Object *Primitive;
+
+        explicit inline SceneView(const Scene &_scene) : scene(_scene) {}
+
+        inline bool intersect(const Ray &ray,
+                              Scalar *const restrict t,
+                              size_t *const restrict index,
+                              Primitive *const restrict primitive) const {
+                *primitive = closestIntersect(ray, scene.objects, t, index);
+                return *primitive != nullptr;
+        }
+
+        inline Vector normal(const Primitive primitive,
+                             const Vector &point) const {
+                return primitive->normal(point);
+        }
+
+        inline MaterialIndex surface(const Primitive primitive,
+                                     const Vector &point) const {
+                return primitive->surface(point);
+        }
+
+        inline const Material &material(const MaterialIndex index) const {
+                return scene.materials[index];
+        }
+
+        inline void shade(Colour *const restrict colour,
+                          const Vector &point,
+                          const Vector &normal,
+                          const Vector &toRay,
+                          const Material *const restrict material,
+                          const size_t maxSamples) const {
+                for (size_t i = 0; i < scene.lights.size(); i++)
+                        *colour += scene.lights[i]->shade(point, normal,
+                                                          toRay, material,
+                                                          scene.objects,
+                                                          maxSamples);
+        }
+
+ private:
+        const Scene &scene;
+};
+
 }  // namespace
 
 namespace rt {
 
+constexpr size_t Renderer::previewDofSamples;
+constexpr size_t Renderer::previewLightSamples;
+constexpr size_t Renderer::previewRayDepth;
+constexpr Scalar Renderer::maxPreviewVariance;
+constexpr size_t Renderer::renderPasses;
+constexpr size_t Renderer::previewPasses;
+
 Renderer::Renderer(const Scene &_scene,
                    const rt::Camera *const restrict _camera,
                    const size_t _numDofSamples,
-                   const size_t _maxRayDepth)
+                   const size_t _maxRayDepth,
+                   const Denoiser *const _denoiser)
                 : scene(_scene), camera(_camera),
                   maxRayDepth(_maxRayDepth),
-                  numDofSamples(_numDofSamples) {}
+                  numDofSamples(_numDofSamples),
+                  denoiser(_denoiser) {}
 
 Renderer::~Renderer() {}
 
+Matrix Renderer::transform(const size_t width, const size_t height) const {
+        // Create a transformation matrix to scale from image
+        // space coordinates (i.e. [x,y] coordinates with
+        // reference to the image size) to camera space
+        // coordinates (i.e. [x,y] coordinates with reference
+        // to the camera's film size).
+        //
+        // Scale image coordinates to camera coordinates.
+        const Scale scale(camera->width / width,
+                          camera->height / height, 1);
+        // Offset from image coordinates to camera coordinates.
+        const Translation offset(-(width * .5), -(height * .5), 0);
+
+        return scale * offset;
+}
+
+bool Renderer::noiseless(const RenderBuffers &storage,
+                         const size_t x,
+                         const size_t y,
+                         const size_t width,
+                         const size_t height) const {
+        const size_t previewWidth = storage.previewWidth;
+        const size_t previewHeight = storage.previewHeight;
+
+        if (!previewWidth || !previewHeight)
+                return false;
+
+        // Find the preview pixel which contains the image pixel.
+        const size_t px = x * previewWidth / width;
+        const size_t py = y * previewHeight / height;
+
+        // Preview pixels are much larger than image pixels, and
+        // sample only their centre, so check the neighbouring
+        // preview pixels too.
+        for (size_t j = py ? py - 1 : 0;
+             j <= std::min(py + 1, previewHeight - 1); j++) {
+                for (size_t i = px ? px - 1 : 0;
+                     i <= std::min(px + 1, previewWidth - 1); i++) {
+                        const size_t index = image::index(i, j, previewWidth);
+                        if (storage.previewVariance[index] >
+                            maxPreviewVariance)
+                                return false;
+                }
+        }
+
+        return true;
+}
+
+bool Renderer::reflective(const Hit &hit) const {
+        return hit.materialId &&
+               scene.materials[hit.materialId - 1].reflectivity > 0;
+}
+
+size_t Renderer::samplePixel(const size_t x,
+                             const size_t y,
+                             const size_t width,
+                             const size_t height,
+                             Cost *const cost) const {
+        const Matrix transformMatrix = transform(width, height);
+        const Quality quality = {numDofSamples,
+                                 std::numeric_limits<size_t>::max(),
+                                 maxRayDepth};
+
+        // Sample the neighbouring pixels.
+        std::array<Sample, 8> neighbours;
+        size_t n = 0;
+        for (int j = -1; j <= 1; j++) {
+                for (int i = -1; i <= 1; i++) {
+                        if (i || j)
+                                neighbours[n++] = Sample(renderPoint(
+                                    static_cast<Scalar>(x) + i + .5,
+                                    static_cast<Scalar>(y) + j + .5,
+                                    transformMatrix, quality));
+                }
+        }
+
+        if (cost)
+                *cost = Cost();
+
+        // Sample the pixel, and supersample it if it differs from
+        // its neighbours.
+        const Sample sample(renderPoint(x + .5, y + .5,
+                                        transformMatrix, quality));
+        Scalar diffSum = 0;
+        for (const auto &neighbour : neighbours)
+                diffSum += sample.diff(neighbour);
+
+        size_t samples = 1, depth = 0;
+        if (diffSum > maxPixelDiff * neighbours.size())
+                renderRegion(x, y, 1, transformMatrix, quality, &samples,
+                             &depth);
+
+        return samples;
+}
 
 Colour Renderer::renderRegion(const Scalar regionX,
                               const Scalar regionY,
                               const Scalar regionSize,
                               const Matrix &transform,
+                              const Quality &quality,
+                              size_t *const restrict sampleCount,
+                              size_t *const restrict reached,
                               const size_t depth) const {
         std::array<Colour, 4> samples;
         Colour supersamples[4];
@@ -109,8 +270,10 @@ Colour Renderer::renderRegion(const Scalar regionX,
                 // Take a sample at the centre of the subregion.
                 *sample++ = renderPoint(x + subregionOffset,
                                         y + subregionOffset,
-                                        transform);
+                                        transform, quality);
         }
+        *sampleCount += 4;
+        *reached = std::max(*reached, depth + 1);
 
         // Determine the average region colour.
         Colour mean;
@@ -143,6 +306,9 @@ Colour Renderer::renderRegion(const Scalar regionX,
                         *sample = renderRegion(x, y,
                                                regionSize / 4,
                                                transform,
+                                               quality,
+                                               sampleCount,
+                                               reached,
                                                depth + 1);
                 }
 
@@ -163,8 +329,14 @@ Colour Renderer::renderRegion(const Scalar regionX,
 
 Colour Renderer::renderPoint(const Scalar x,
                              const Scalar y,
-                             const Matrix &transform) const {
+                             const Matrix &transform,
+                             const Quality &quality,
+                             Hit *const restrict hit,
+                             float *const restrict variance) const {
+        const size_t numSamples = quality.dofSamples;
         Colour output;
+        // Sum of squared sample values, for variance.
+        Colour squares;
 
         // Convert image to camera space coordinates.
         const Vector imageOrigin = transform * Vector(x, y, 0);
@@ -184,8 +356,8 @@ Colour Renderer::renderPoint(const Scalar x,
         const Vector focalPoint = camera->filmBack +
                                   focalDirection * camera->focusDistance;
 
-        // Accumulate numDofSamples samples.
-        for (size_t i = 0; i < numDofSamples; i++) {
+        // Accumulate numSamples samples.
+        for (size_t i = 0; i < numSamples; i++) {
                 // Convert image to camera space coordinates.
                 const Vector cameraSpace = imageOrigin +
                                 camera->lens.aperture();
@@ -205,58 +377,30 @@ Colour Renderer::renderPoint(const Scalar x,
                 // Create a ray.
                 const Ray ray = Ray(worldSpace, direction);
 
-                // Sample the ray.
-                output += trace(ray) / numDofSamples;
+                // Sample the ray. Only the first sample records a
+                // hit.
+                const Colour sample = trace(ray, quality, 0,
+                                            i ? nullptr : hit);
+                output += sample / numSamples;
+                if (variance)
+                        squares += sample * sample / numSamples;
         }
 
+        // Sum the variance of the colour components.
+        if (variance)
+                *variance = static_cast<float>(
+                    squares.r - output.r * output.r +
+                    squares.g - output.g * output.g +
+                    squares.b - output.b * output.b);
+
         return output;
 }
 
 Colour Renderer::trace(const Ray &ray,
-                       const unsigned int depth) const {
-        Colour colour;
-
-        // Bump profiling counter.
-        profiling::counters::incTraceCount();
-
-        // Determine the closet ray-object intersection (if any).
-        Scalar t;
-        const Object *const restrict object =
-                        closestIntersect(ray, scene.objects, &t);
-        // If the ray doesn't intersect any object, do nothing.
-        if (object == nullptr)
-                return colour;
-
-        // Point of intersection.
-        const Vector intersect = ray.position + ray.direction * t;
-        // Surface normal at point of intersection.
-        const Vector normal = object->normal(intersect);
-        // Direction between intersection and source ray.
-        const Vector toRay = (ray.position - intersect).normalise();
-        // Material at point of intersection.
-        const Material *material = object->surface(intersect);
-
-        // Apply ambient lighting.
-        colour += material->colour * material->ambient;
-
-        // Apply shading from each light source.
-        for (size_t i = 0; i < scene.lights.size(); i++)
-                colour += scene.lights[i]->shade(intersect, normal, toRay,
-                                                  material, scene.objects);
-
-        // Create reflection ray and recursive evaluate.
-        const Scalar reflectivity = material->reflectivity;
-        if (depth < maxRayDepth && reflectivity > 0) {
-                // Direction of reflected ray.
-                const Vector reflectionDirection = (normal * 2*(normal ^ toRay)
-                                                    - toRay).normalise();
-                // Create a reflection.
-                const Ray reflection(intersect, reflectionDirection);
-                // Add reflection light.
-                colour += trace(reflection, depth + 1) * reflectivity;
-        }
-
-        return colour;
+                       const Quality &quality,
+                       const unsigned int depth,
+                       Hit *const restrict hit) const {
+        return traceScene(SceneView(scene), ray, quality, depth, hit);
 }
 
 }  // namespace rt
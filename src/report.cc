@@ -0,0 +1,276 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "rt/report.h"
+
+#include <array>
+#include <cinttypes>
+#include <cstdio>
+
+#include "tbb/task_arena.h"
+
+namespace rt {
+
+namespace {
+
+// Write a string as a JSON string literal.
+void string(std::ostream &out, const std::string &value) {
+        out << '"';
+        for (const char c : value) {
+                if (c == '"' || c == '\\') {
+                        out << '\\' << c;
+                } else if (static_cast<unsigned char>(c) < 0x20) {
+                        char escaped[7];
+                        snprintf(escaped, sizeof(escaped), "\\u%04x",
+                                 static_cast<unsigned>(c));
+                        out << escaped;
+                } else {
+                        out << c;
+                }
+        }
+        out << '"';
+}
+
+// Write hardware event counts as a JSON object.
+void hardware(std::ostream &out, const profiling::HardwareCounts &counts) {
+        out << "{\"cycles\": " << counts.cycles
+            << ", \"instructions\": " << counts.instructions
+            << ", \"ipc\": " << counts.ipc()
+            << ", \"cacheMisses\": " << counts.cacheMisses
+            << ", \"branchMisses\": " << counts.branchMisses << "}";
+}
+
+// A histogram of a render's counts, with its name in reports and
+// its title when printed.
+class NamedHistogram {
+ public:
+        const char *name;
+        const char *title;
+        profiling::Histogram profiling::Counts::*histogram;
+};
+
+const std::array<NamedHistogram, 5> histograms = {{
+        {"reflectionDepth", "Reflection depth per primary ray",
+         &profiling::Counts::reflectionDepth},
+        {"traceTests", "Intersection tests per traced ray",
+         &profiling::Counts::traceTests},
+        {"shadowTests", "Intersection tests per shadow ray",
+         &profiling::Counts::shadowTests},
+        {"shadowRaysPerPoint", "Shadow rays per shading point",
+         &profiling::Counts::shadowRaysPerPoint},
+        {"supersampleDepth", "Supersampling depth per pixel",
+         &profiling::Counts::supersampleDepth}
+}};
+
+// Return the number of buckets up to and including the last
+// non-empty bucket of a histogram.
+size_t used(const profiling::Histogram &histogram) {
+        size_t n = histogram.size;
+        while (n && !histogram.buckets[n - 1])
+                n--;
+        return n;
+}
+
+// Write a histogram as a JSON object.
+void histogram(std::ostream &out, const profiling::Histogram &histogram) {
+        out << "{\"count\": " << histogram.count
+            << ", \"mean\": " << histogram.mean()
+            << ", \"max\": " << histogram.max << ", \"buckets\": [";
+        for (size_t i = 0; i < used(histogram); i++)
+                out << (i ? ", " : "") << "{\"min\": "
+                    << profiling::Histogram::lower(i)
+                    << ", \"count\": " << histogram.buckets[i] << "}";
+        out << "]}";
+}
+
+// Print a histogram, with a bar for each bucket from the first to
+// the last non-empty bucket.
+void print(const char *const title, const profiling::Histogram &histogram) {
+        printf("\n%s (mean %.2f, max %" PRIu64 "):\n", title,
+               histogram.mean(), histogram.max);
+
+        size_t first = 0;
+        while (!histogram.buckets[first])
+                first++;
+
+        for (size_t i = first; i < used(histogram); i++) {
+                const profiling::Counter lower =
+                                profiling::Histogram::lower(i);
+                const profiling::Counter upper =
+                                profiling::Histogram::lower(i + 1) - 1;
+                char range[32];
+                if (i == histogram.size - 1)
+                        snprintf(range, sizeof(range), "%" PRIu64 "+", lower);
+                else if (lower == upper || !i)
+                        snprintf(range, sizeof(range), "%" PRIu64, lower);
+                else
+                        snprintf(range, sizeof(range),
+                                 "%" PRIu64 "-%" PRIu64, lower, upper);
+
+                const double fraction =
+                                static_cast<double>(histogram.buckets[i]) /
+                                histogram.count;
+                printf("\t%-16s %12" PRIu64 " %6.1f%% %s\n", range,
+                       histogram.buckets[i], 100 * fraction,
+                       std::string(static_cast<size_t>(fraction * 40 + .5),
+                                   '#').c_str());
+        }
+}
+
+// Return whether a tree of phases counted hardware events.
+bool countsHardware(const profiling::Phases &tree) {
+        return tree.hardware && tree.hardware->available();
+}
+
+// Write the children of a phase as a JSON array.
+void phases(std::ostream &out,
+            const profiling::Phases &tree,
+            const size_t parent,
+            const std::string &indent) {
+        const std::vector<size_t> children = tree.children(parent);
+
+        out << "[";
+        for (size_t i = 0; i < children.size(); i++) {
+                const profiling::Phases::Node &node =
+                                tree.nodes()[children[i]];
+
+                out << (i ? ",\n" : "\n") << indent << "  {\"name\": ";
+                string(out, node.name);
+                out << ", \"calls\": " << node.calls
+                    << ", \"seconds\": " << node.seconds;
+                if (node.threads)
+                        out << ", \"threads\": " << node.threads
+                            << ", \"utilisation\": " << node.utilisation();
+                if (countsHardware(tree)) {
+                        out << ", \"hardware\": ";
+                        hardware(out, node.hardware);
+                }
+                if (!tree.children(children[i]).empty()) {
+                        out << ", \"phases\": ";
+                        phases(out, tree, children[i], indent + "  ");
+                }
+                out << "}";
+        }
+        if (!children.empty())
+                out << "\n" << indent;
+        out << "]";
+}
+
+// Print the children of a phase, indented by depth.
+void print(const profiling::Phases &tree,
+           const size_t parent,
+           const size_t depth) {
+        for (const size_t child : tree.children(parent)) {
+                const profiling::Phases::Node &node = tree.nodes()[child];
+                const int width = static_cast<int>(24 - 2 * depth);
+
+                printf("\t%*s%-*s %8.3f s", static_cast<int>(2 * depth), "",
+                       width > 0 ? width : 0, node.name.c_str(),
+                       node.seconds);
+                if (countsHardware(tree))
+                        printf("  %5.2f IPC", node.hardware.ipc());
+                if (node.threads)
+                        printf("  %5.1f%% of %lu threads",
+                               node.utilisation() * 100, node.threads);
+                printf("\n");
+
+                print(tree, child, depth + 1);
+        }
+}
+
+}  // namespace
+
+std::ostream &operator<<(std::ostream &out, const Report &report) {
+        const profiling::Counts &counts = *report.counts;
+
+        out << "{\n";
+        out << "  \"image\": {\"path\": ";
+        string(out, report.path);
+        out << ", \"width\": " << report.width
+            << ", \"height\": " << report.height
+            << ", \"pixels\": " << report.width * report.height << "},\n";
+        out << "  \"threads\": "
+            << tbb::this_task_arena::max_concurrency() << ",\n";
+        out << "  \"instrumentation\": " << profiling::instrumentation
+            << ",\n";
+        out << "  \"seconds\": " << report.seconds << ",\n";
+        out << "  \"counts\": {"
+            << "\"traces\": " << counts.traces
+            << ", \"rays\": " << counts.rays
+            << ", \"shadowRays\": " << counts.shadowRays
+            << ", \"intersections\": " << counts.intersections;
+        if (profiling::instrumentation >= 2)
+                out << ", \"reflections\": " << counts.reflections
+                    << ", \"shadowIntersections\": "
+                    << counts.shadowIntersections
+                    << ", \"chunkVisits\": " << counts.chunkVisits;
+        out << "},\n";
+        if (profiling::instrumentation >= 2) {
+                out << "  \"lightSamplings\": {\"lit\": " << counts.lit
+                    << ", \"penumbra\": " << counts.penumbra
+                    << ", \"umbra\": " << counts.umbra << "},\n";
+                out << "  \"histograms\": {";
+                for (size_t i = 0; i < histograms.size(); i++) {
+                        out << (i ? ",\n" : "\n") << "    \""
+                            << histograms[i].name << "\": ";
+                        histogram(out, counts.*histograms[i].histogram);
+                }
+                out << "\n  },\n";
+        }
+        if (report.hardware) {
+                out << "  \"hardware\": ";
+                hardware(out, *report.hardware);
+                out << ",\n";
+        }
+        out << "  \"phases\": ";
+        if (report.phases)
+                phases(out, *report.phases, profiling::Phases::none, "  ");
+        else
+                out << "[]";
+        out << "\n}\n";
+
+        return out;
+}
+
+void printPhases(const profiling::Phases &tree) {
+        print(tree, profiling::Phases::none, 0);
+}
+
+void printHistograms(const profiling::Counts &counts) {
+        const profiling::Counter samplings =
+                        counts.lit + counts.penumbra + counts.umbra;
+        if (samplings) {
+                printf("\nLight samplings from shading points:\n");
+                printf("\tFully lit:\t\t%.1f%%\n",
+                       100. * counts.lit / samplings);
+                printf("\tPartially shadowed:\t%.1f%%\n",
+                       100. * counts.penumbra / samplings);
+                printf("\tFully shadowed:\t\t%.1f%%\n",
+                       100. * counts.umbra / samplings);
+        }
+
+        for (const auto &named : histograms) {
+                const profiling::Histogram &histogram =
+                                counts.*named.histogram;
+                if (histogram.count)
+                        print(named.title, histogram);
+        }
+}
+
+}  // namespace rt
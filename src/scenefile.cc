@@ -0,0 +1,840 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "rt/scenefile.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <utility>
+
+#include "rt/chunks.h"
+#include "rt/lights.h"
+#include "rt/sceneformat.h"
+
+namespace rt {
+
+namespace {
+
+// The maximum nesting depth of @import directives, and of macros
+// which expand to other macros. Deeper nesting is assumed to be a
+// cycle.
+static const size_t maxNestingDepth = 64;
+
+// A token, along with the file and line that it was read from.
+class Token {
+ public:
+        std::string text;
+        std::string file;
+        size_t line = 0;
+};
+
+typedef std::vector<Token> Tokens;
+
+// A section: its "[Name]" header token, followed by its body.
+class Section {
+ public:
+        Token header;
+        Tokens body;
+};
+
+// The "Key: value" pairs of a section, with lower case keys.
+typedef std::map<std::string, Tokens> Pairs;
+
+// The components of a vector.
+typedef std::array<Scalar, 3> Triple;
+
+// Camera lens settings.
+class LensSettings {
+ public:
+        Scalar focalLength;
+        Scalar aperture;
+        Scalar focus;
+};
+
+// Camera film settings.
+class FilmSettings {
+ public:
+        Colour gamma;
+        Scalar saturation;
+        size_t width;
+        size_t height;
+};
+
+// Return the vector of a triple.
+inline Vector vector(const Triple &v) {
+        return Vector(v[0], v[1], v[2]);
+}
+
+// Return a lower case copy of a string.
+std::string lower(std::string s) {
+        for (auto &c : s)
+                c = static_cast<char>(tolower(c));
+        return s;
+}
+
+// Return the directory component of a path, including the trailing
+// separator, or an empty string if there is none.
+std::string dirname(const std::string &path) {
+        const size_t separator = path.rfind('/');
+        return separator == std::string::npos ?
+                        "" : path.substr(0, separator + 1);
+}
+
+// Scene file parser. Objects created while parsing are owned by the
+// parser until they are handed over to a scene file by build().
+class Parser {
+ public:
+        explicit Parser(std::string *const _error)
+                : error(_error),
+                  rayDepth(100),
+                  scale(1),
+                  dofSamples(1),
+                  path("render.ppm"),
+                  lightBase(3),
+                  lightScaleFactor(.01),
+                  camera(nullptr) {}
+
+        ~Parser() {
+                delete camera;
+        }
+
+        // Read, preprocess, and parse a file.
+        bool parse(const std::string &file) {
+                Tokens tokens;
+
+                if (!read(file, &tokens, 0))
+                        return false;
+
+                for (const auto &section : sections(tokens))
+                        if (!parseSection(section))
+                                return false;
+
+                if (!camera) {
+                        *error = file + ": no camera defined";
+                        return false;
+                }
+
+                return true;
+        }
+
+        // Transfer the parsed scene to a scene file.
+        void build(SceneFile *const out) {
+                out->scene = new Scene(std::move(arena),
+                                       std::move(table),
+                                       Objects(objects.begin(), objects.end()),
+                                       Lights(lights.begin(), lights.end()));
+                out->camera = camera;
+                out->rayDepth = rayDepth;
+                out->dofSamples = dofSamples;
+                out->path = path;
+                out->scale = scale;
+                out->saturation = film.saturation;
+                out->gamma = film.gamma;
+
+                objects.clear();
+                lights.clear();
+                camera = nullptr;
+        }
+
+ private:
+        std::string *const error;
+
+        // Preprocessor macros.
+        std::map<std::string, std::string> macros;
+
+        // Named definitions.
+        std::map<std::string, MaterialIndex> materials;
+        std::map<std::string, LensSettings> lenses;
+        std::map<std::string, FilmSettings> films;
+
+        // Renderer settings.
+        size_t rayDepth;
+        size_t scale;
+        size_t dofSamples;
+        std::string path;
+        size_t lightBase;
+        Scalar lightScaleFactor;
+
+        // The scene. Objects and lights are allocated from the arena,
+        // and refer to materials in the table.
+        Arena arena;
+        Materials table;
+        std::vector<const Object *> objects;
+        std::vector<const Light *> lights;
+        const Camera *camera;
+        FilmSettings film;
+
+        // Set the error message for a token, and return false.
+        bool fail(const Token &at, const std::string &message) {
+                std::ostringstream s;
+                s << at.file << ":" << at.line << ": " << message;
+                *error = s.str();
+                return false;
+        }
+
+        // Split a file into tokens. Tokens are separated by
+        // whitespace, unless quoted, and "#" comments run to the end
+        // of the line.
+        bool tokenise(const std::string &file, Tokens *const tokens) {
+                // The stream's buffer is large, and this is inlined
+                // into the recursive read(), so keep it off the stack.
+                const auto in = std::make_unique<std::ifstream>(file);
+                if (!*in) {
+                        *error = file + ": could not open file";
+                        return false;
+                }
+
+                bool inQuotes = false, inComment = false;
+                Token token = {"", file, 1};
+                size_t line = 1;
+
+                // Append the current token, if any.
+                const auto flush = [&]() {
+                        if (!token.text.empty())
+                                tokens->push_back(token);
+                        token.text.clear();
+                        token.line = line;
+                };
+
+                for (char c; in->get(c);) {
+                        if (c == '\n' || c == '\r') {
+                                if (c == '\n')
+                                        line++;
+                                inComment = false;
+                                if (inQuotes)
+                                        token.text += c;
+                                else
+                                        flush();
+                        } else if (inComment) {
+                                continue;
+                        } else if (c == '#' && !inQuotes) {
+                                inComment = true;
+                        } else if (c == '"') {
+                                inQuotes = !inQuotes;
+                                flush();
+                        } else if ((c == ' ' || c == '\t') && !inQuotes) {
+                                flush();
+                        } else {
+                                if (token.text.empty())
+                                        token.line = line;
+                                token.text += c;
+                        }
+                }
+                flush();
+
+                return true;
+        }
+
+        // Expand a token if it is a macro.
+        bool expand(Token *const token) {
+                for (size_t i = 0; token->text[0] == '@'; i++) {
+                        const auto macro = macros.find(token->text.substr(1));
+                        if (macro == macros.end())
+                                return true;
+                        if (i == maxNestingDepth)
+                                return fail(*token, "recursive macro '" +
+                                            token->text + "'");
+                        token->text = macro->second;
+                }
+
+                return true;
+        }
+
+        // Tokenise a file, expanding macros and imports.
+        bool read(const std::string &file, Tokens *const out,
+                  const size_t depth) {
+                Tokens tokens;
+
+                if (!tokenise(file, &tokens))
+                        return false;
+
+                for (size_t i = 0; i < tokens.size(); i++) {
+                        Token token = tokens[i];
+
+                        if (!expand(&token))
+                                return false;
+
+                        const std::string directive = lower(token.text);
+                        if (directive == "@import") {
+                                if (i + 1 >= tokens.size())
+                                        return fail(token, "missing path");
+                                Token import = tokens[++i];
+                                if (!expand(&import))
+                                        return false;
+                                if (depth == maxNestingDepth)
+                                        return fail(import, "recursive import");
+
+                                // Relative paths are relative to the
+                                // importing file.
+                                const std::string importPath =
+                                                import.text[0] == '/' ?
+                                                import.text :
+                                                dirname(file) + import.text;
+                                if (!read(importPath, out, depth + 1))
+                                        return false;
+                        } else if (directive == "@def") {
+                                if (i + 2 >= tokens.size())
+                                        return fail(token, "incomplete @def");
+                                Token name = tokens[++i];
+                                Token value = tokens[++i];
+                                if (!expand(&name) || !expand(&value))
+                                        return false;
+                                macros[name.text] = value.text;
+                        } else {
+                                out->push_back(token);
+                        }
+                }
+
+                return true;
+        }
+
+        // Split tokens into sections.
+        static std::vector<Section> sections(const Tokens &tokens) {
+                std::vector<Section> sections;
+
+                for (const auto &token : tokens) {
+                        const std::string &text = token.text;
+                        if (text.size() > 1 && text.front() == '[' &&
+                            text.back() == ']') {
+                                Section section;
+                                section.header = token;
+                                section.header.text = lower(
+                                    text.substr(1, text.size() - 2));
+                                sections.push_back(section);
+                        } else if (sections.size()) {
+                                sections.back().body.push_back(token);
+                        } else {
+                                // Tokens before the first section
+                                // form a nameless section, which is an
+                                // error.
+                                Section section;
+                                section.header = token;
+                                section.header.text = "";
+                                section.body.push_back(token);
+                                sections.push_back(section);
+                        }
+                }
+
+                return sections;
+        }
+
+        // Split a section body into "Key: value" pairs.
+        bool pairs(const Section &section, Pairs *const out) {
+                std::string key;
+
+                for (const auto &token : section.body) {
+                        if (token.text.back() == ':') {
+                                key = lower(token.text.substr(
+                                    0, token.text.size() - 1));
+                                if (out->count(key))
+                                        return fail(token, "duplicate key '" +
+                                                    key + "'");
+                                (*out)[key] = Tokens();
+                        } else if (key.empty()) {
+                                return fail(token, "value without key '" +
+                                            token.text + "'");
+                        } else {
+                                (*out)[key].push_back(token);
+                        }
+                }
+
+                return true;
+        }
+
+        // Remove a key from a set of pairs, and return its value as a
+        // single string. Returns false if the key is not present.
+        static bool take(Pairs *const pairs, const std::string &key,
+                         Token *const value) {
+                const auto pair = pairs->find(key);
+                if (pair == pairs->end())
+                        return false;
+
+                *value = pair->second.size() ? pair->second[0] : Token();
+                value->text.clear();
+                for (const auto &token : pair->second)
+                        value->text += token.text;
+                pairs->erase(pair);
+
+                return true;
+        }
+
+        // Consume a number, or use the default if not present.
+        bool consume(Pairs *const pairs, const std::string &key,
+                     Scalar *const value, const Scalar fallback) {
+                Token token;
+                if (!take(pairs, key, &token)) {
+                        *value = fallback;
+                        return true;
+                }
+
+                return number(token, value);
+        }
+
+        // Consume a non-negative integer, or use the default if not
+        // present.
+        bool consume(Pairs *const pairs, const std::string &key,
+                     size_t *const value, const size_t fallback) {
+                Token token;
+                Scalar n;
+                if (!take(pairs, key, &token)) {
+                        *value = fallback;
+                        return true;
+                }
+                if (!number(token, &n))
+                        return false;
+                if (n < 0 || std::floor(n) != n)
+                        return fail(token, "'" + key +
+                                    "' must be a whole number");
+
+                *value = static_cast<size_t>(n);
+                return true;
+        }
+
+        // Consume a percentage, returning it as a fraction.
+        bool consumePercent(Pairs *const pairs, const std::string &key,
+                            Scalar *const value, const Scalar fallback) {
+                if (!consume(pairs, key, value, fallback * 100))
+                        return false;
+
+                *value /= 100;
+                return true;
+        }
+
+        // Consume a "0xrrggbb" colour, or use the default if not
+        // present.
+        bool consume(Pairs *const pairs, const std::string &key,
+                     Colour *const value, const Colour &fallback) {
+                Token token;
+                if (!take(pairs, key, &token)) {
+                        *value = fallback;
+                        return true;
+                }
+
+                const std::string &text = token.text;
+                char *end;
+                const long hex = strtol(text.c_str(), &end, 16);
+                if (text.size() != 8 || lower(text.substr(0, 2)) != "0x" ||
+                    *end)
+                        return fail(token, "unrecognised colour '" +
+                                    text + "'");
+
+                *value = Colour(static_cast<int>(hex));
+                return true;
+        }
+
+        // Consume an "x y z" triple, or use zeros if not present.
+        bool consume(Pairs *const pairs, const Section &section,
+                     const std::string &key, Triple *const value) {
+                const auto pair = pairs->find(key);
+                *value = {0, 0, 0};
+                if (pair == pairs->end())
+                        return true;
+
+                const Tokens tokens = pair->second;
+                pairs->erase(pair);
+
+                if (tokens.size() != 3)
+                        return fail(tokens.size() ? tokens[0] :
+                                    section.header,
+                                    "'" + key + "' must have 3 components");
+                for (size_t i = 0; i < 3; i++)
+                        if (!number(tokens[i], &(*value)[i]))
+                                return false;
+
+                return true;
+        }
+
+        // Consume a string, or use the default if not present.
+        static void consume(Pairs *const pairs, const std::string &key,
+                            std::string *const value,
+                            const std::string &fallback) {
+                Token token;
+                *value = take(pairs, key, &token) ? token.text : fallback;
+        }
+
+        // Consume a required "$Type.name" reference, and return the
+        // name.
+        bool consumeReference(Pairs *const pairs, const Section &section,
+                              const std::string &key, const std::string &type,
+                              std::string *const name) {
+                Token token;
+                if (!take(pairs, key, &token))
+                        return fail(section.header, "missing '" + key + "'");
+
+                const std::string prefix = "$" + type + ".";
+                if (token.text.size() <= prefix.size() ||
+                    lower(token.text.substr(0, prefix.size())) != prefix)
+                        return fail(token, "invalid " + type + " name '" +
+                                    token.text + "'");
+
+                *name = token.text.substr(prefix.size());
+                return true;
+        }
+
+        // Consume a required material reference.
+        bool consumeMaterial(Pairs *const pairs, const Section &section,
+                             const std::string &key,
+                             MaterialIndex *const material) {
+                std::string name;
+                if (!consumeReference(pairs, section, key, "material", &name))
+                        return false;
+
+                const auto match = materials.find(name);
+                if (match == materials.end())
+                        return fail(section.header, "no material named '" +
+                                    name + "'");
+
+                *material = match->second;
+                return true;
+        }
+
+        // Parse a number.
+        bool number(const Token &token, Scalar *const value) {
+                const char *const text = token.text.c_str();
+                char *end;
+
+                errno = 0;
+                *value = strtod(text, &end);
+                if (end == text || *end || errno)
+                        return fail(token, "invalid number '" +
+                                    token.text + "'");
+
+                return true;
+        }
+
+        // Check that all of a section's keys were consumed.
+        bool done(const Section &section, const Pairs &pairs) {
+                if (pairs.empty())
+                        return true;
+
+                const auto &pair = *pairs.begin();
+                return fail(pair.second.size() ? pair.second[0] :
+                            section.header, "unrecognised attribute '" +
+                            pair.first + "' in section '" +
+                            section.header.text + "'");
+        }
+
+        // Return whether a name starts with a prefix, and if so,
+        // return the remainder.
+        static bool named(const std::string &name, const std::string &prefix,
+                          std::string *const rest) {
+                if (name.size() <= prefix.size() ||
+                    name.compare(0, prefix.size(), prefix))
+                        return false;
+
+                *rest = name.substr(prefix.size());
+                return true;
+        }
+
+        // Parse a single section.
+        bool parseSection(const Section &section) {
+                const std::string &type = section.header.text;
+                std::string name;
+                Pairs p;
+
+                if (type.empty())
+                        return fail(section.header, "expected a section");
+                if (!pairs(section, &p))
+                        return false;
+
+                if (type == "renderer") {
+                        if (!consume(&p, "raydepth", &rayDepth, 100) ||
+                            !consume(&p, "scale", &scale, 1) ||
+                            !consume(&p, "dofsamples", &dofSamples, 1))
+                                return false;
+                        consume(&p, "path", &path, "render.ppm");
+                } else if (type == "renderer.antialiasing") {
+                        // No settings.
+                } else if (type == "renderer.softlights") {
+                        if (!consume(&p, "base", &lightBase, 3) ||
+                            !consume(&p, "scalefactor", &lightScaleFactor,
+                                     .01))
+                                return false;
+                } else if (named(type, "material.", &name)) {
+                        if (!parseMaterial(section, name, &p))
+                                return false;
+                } else if (named(type, "lens.", &name)) {
+                        if (!parseLens(section, name, &p))
+                                return false;
+                } else if (named(type, "film.", &name)) {
+                        if (!parseFilm(section, name, &p))
+                                return false;
+                } else if (type == "camera.perspective") {
+                        if (!parseCamera(section, &p))
+                                return false;
+                } else if (type == "object.plane" ||
+                           type == "object.checkerboard" ||
+                           type == "object.sphere") {
+                        if (!parseObject(section, &p))
+                                return false;
+                } else if (type == "light.soft" || type == "light.point") {
+                        if (!parseLight(section, &p))
+                                return false;
+                } else {
+                        return fail(section.header, "unknown section '" +
+                                    type + "'");
+                }
+
+                return done(section, p);
+        }
+
+        bool parseMaterial(const Section &section, const std::string &name,
+                           Pairs *const p) {
+                Colour colour;
+                Scalar ambient, diffuse, specular, shininess, reflectivity;
+
+                if (materials.count(name))
+                        return fail(section.header, "duplicate material '" +
+                                    name + "'");
+                if (!consume(p, "colour", &colour, Colour(0)) ||
+                    !consumePercent(p, "ambient", &ambient, 0) ||
+                    !consumePercent(p, "diffuse", &diffuse, 0) ||
+                    !consumePercent(p, "specular", &specular, 0) ||
+                    !consume(p, "shininess", &shininess, 0) ||
+                    !consumePercent(p, "reflectivity", &reflectivity, 0))
+                        return false;
+
+                materials[name] = table.add(Material(colour, ambient,
+                                                     diffuse, specular,
+                                                     shininess,
+                                                     reflectivity));
+                return true;
+        }
+
+        bool parseLens(const Section &section, const std::string &name,
+                       Pairs *const p) {
+                LensSettings lens;
+
+                if (lenses.count(name))
+                        return fail(section.header, "duplicate lens '" +
+                                    name + "'");
+                if (!consume(p, "focallength", &lens.focalLength, 0) ||
+                    !consume(p, "aperture", &lens.aperture, 1) ||
+                    !consume(p, "focus", &lens.focus, 1))
+                        return false;
+
+                lenses[name] = lens;
+                return true;
+        }
+
+        bool parseFilm(const Section &section, const std::string &name,
+                       Pairs *const p) {
+                FilmSettings settings;
+
+                if (films.count(name))
+                        return fail(section.header, "duplicate film '" +
+                                    name + "'");
+                if (!consumePercent(p, "saturation", &settings.saturation, 1) ||
+                    !consume(p, "width", &settings.width, 0) ||
+                    !consume(p, "height", &settings.height, 0))
+                        return false;
+
+                // Gamma is given as R,G,B percentages.
+                settings.gamma = Colour(1, 1, 1);
+                if (p->count("rgbgamma")) {
+                        Triple gamma;
+                        if (!consume(p, section, "rgbgamma", &gamma))
+                                return false;
+                        settings.gamma = Colour(gamma[0] / 100,
+                                                gamma[1] / 100,
+                                                gamma[2] / 100);
+                }
+
+                films[name] = settings;
+                return true;
+        }
+
+        bool parseCamera(const Section &section, Pairs *const p) {
+                Triple position, lookAt;
+                std::string lensName, filmName;
+
+                if (camera)
+                        return fail(section.header, "duplicate camera");
+                if (!consume(p, section, "position", &position) ||
+                    !consume(p, section, "lookat", &lookAt) ||
+                    !consumeReference(p, section, "lens", "lens", &lensName) ||
+                    !consumeReference(p, section, "film", "film", &filmName))
+                        return false;
+
+                const auto lens = lenses.find(lensName);
+                if (lens == lenses.end())
+                        return fail(section.header, "no lens named '" +
+                                    lensName + "'");
+                const auto match = films.find(filmName);
+                if (match == films.end())
+                        return fail(section.header, "no film named '" +
+                                    filmName + "'");
+
+                film = match->second;
+                camera = new Camera(vector(position), vector(lookAt),
+                                    film.width, film.height,
+                                    Lens(lens->second.focalLength,
+                                         lens->second.aperture,
+                                         lens->second.focus));
+                return true;
+        }
+
+        bool parseObject(const Section &section, Pairs *const p) {
+                const std::string &type = section.header.text;
+                Triple position, direction;
+                MaterialIndex material, material2;
+                Scalar size;
+
+                if (!consume(p, section, "position", &position))
+                        return false;
+
+                if (type == "object.sphere") {
+                        if (!consume(p, "size", &size, 0) ||
+                            !consumeMaterial(p, section, "material",
+                                             &material))
+                                return false;
+                        objects.push_back(arena.make<Sphere>(
+                            vector(position), size, material));
+                        return true;
+                }
+
+                if (!consume(p, section, "direction", &direction))
+                        return false;
+
+                if (type == "object.plane") {
+                        if (!consumeMaterial(p, section, "material",
+                                             &material))
+                                return false;
+                        objects.push_back(arena.make<Plane>(
+                            vector(position), vector(direction), material));
+                } else {
+                        if (!consume(p, "size", &size, 0) ||
+                            !consumeMaterial(p, section, "material1",
+                                             &material) ||
+                            !consumeMaterial(p, section, "material2",
+                                             &material2))
+                                return false;
+                        objects.push_back(arena.make<CheckerBoard>(
+                            vector(position), vector(direction), size,
+                            material, material2));
+                }
+
+                return true;
+        }
+
+        bool parseLight(const Section &section, Pairs *const p) {
+                Triple position;
+                Colour colour;
+
+                if (!consume(p, section, "position", &position) ||
+                    !consume(p, "colour", &colour, Colour(0)))
+                        return false;
+
+                if (section.header.text == "light.point") {
+                        lights.push_back(arena.make<SoftLight>(
+                            vector(position), colour));
+                        return true;
+                }
+
+                Scalar size;
+                if (!consume(p, "size", &size, 0))
+                        return false;
+
+                // The number of samples is:
+                //
+                //    N = Nb + (r*s)^3
+                //
+                // Where: Nb is the base number of samples.
+                //        r  is the radius of the soft light.
+                //        s  is the soft light scale factor.
+                const size_t samples = static_cast<size_t>(std::ceil(
+                    lightBase + std::pow(size * lightScaleFactor, 3)));
+
+                lights.push_back(arena.make<SoftLight>(
+                    vector(position), colour, size,
+                    std::max(samples, static_cast<size_t>(1))));
+                return true;
+        }
+};
+
+}  // namespace
+
+SceneFile::SceneFile()
+                : scene(nullptr),
+                  camera(nullptr),
+                  chunks(nullptr),
+                  rayDepth(0),
+                  dofSamples(0),
+                  scale(1),
+                  saturation(1),
+                  gamma(Colour(1, 1, 1)),
+                  storage(nullptr) {}
+
+SceneFile::SceneFile(const Scene *const _scene, const Camera *const _camera)
+                : scene(_scene),
+                  camera(_camera),
+                  chunks(nullptr),
+                  rayDepth(100),
+                  dofSamples(1),
+                  path("render.ppm"),
+                  scale(1),
+                  saturation(1),
+                  gamma(Colour(1, 1, 1)),
+                  storage(nullptr) {}
+
+SceneFile::~SceneFile() {
+        delete scene;
+        delete camera;
+        delete chunks;
+        delete storage;
+}
+
+SceneFile *SceneFile::load(const std::string &path,
+                           std::string *const error,
+                           const size_t cacheSize) {
+        // Streams and the parser are large, so keep them off the stack.
+        char signature[sizeof(sceneformat::magic)] = {};
+        bool read;
+        {
+                const auto in = std::make_unique<std::ifstream>(
+                    path, std::ios::binary);
+                read = static_cast<bool>(in->read(signature,
+                                                  sizeof(signature)));
+        }
+        const bool binary = read && std::equal(signature,
+                                               signature + sizeof(signature),
+                                               sceneformat::magic);
+
+        if (binary)
+                return loadBinary(path, error, cacheSize);
+
+        const auto parser = std::make_unique<Parser>(error);
+        SceneFile *file = nullptr;
+
+        if (parser->parse(path)) {
+                file = new SceneFile();
+                parser->build(file);
+        }
+
+        return file;
+}
+
+}  // namespace rt
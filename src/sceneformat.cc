@@ -0,0 +1,519 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "rt/sceneformat.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "rt/chunks.h"
+#include "rt/lights.h"
+#include "rt/scenefile.h"
+
+namespace rt {
+
+namespace sceneformat {
+
+namespace {
+
+// Return whether an array lies within a file of the given size.
+bool contains(const size_t size, const Array &array,
+              const size_t recordSize) {
+        return !(array.offset % alignment) && array.offset <= size &&
+                        array.count <= (size - array.offset) / recordSize;
+}
+
+// Return the records of an array.
+template <typename T>
+const T *records(const void *const data, const Array &array) {
+        return reinterpret_cast<const T *>(
+            static_cast<const char *>(data) + array.offset);
+}
+
+inline Vector vector(const double *const v) {
+        return Vector(v[0], v[1], v[2]);
+}
+
+inline Colour colour(const double *const v) {
+        Colour c;
+
+        c.r = v[0];
+        c.g = v[1];
+        c.b = v[2];
+        return c;
+}
+
+inline void store(double *const out, const Vector &v) {
+        out[0] = v.x;
+        out[1] = v.y;
+        out[2] = v.z;
+}
+
+inline void store(double *const out, const Colour &c) {
+        out[0] = c.r;
+        out[1] = c.g;
+        out[2] = c.b;
+}
+
+// Round an offset up to the array alignment.
+inline uint64_t align(const uint64_t offset) {
+        return (offset + alignment - 1) / alignment * alignment;
+}
+
+// Place an array of records at the end of the file.
+template <typename T>
+void place(Array *const array, const size_t count, uint64_t *const end) {
+        array->offset = align(*end);
+        array->count = count;
+        *end = array->offset + count * sizeof(T);
+}
+
+// Partition the spheres in [begin, end) into runs of at most "size"
+// spheres, by recursively splitting them at the median of the
+// longest axis of their centres. Appends the end of each run to
+// "ends".
+void partition(SphereRecord *const spheres,
+               const size_t begin,
+               const size_t end,
+               const size_t size,
+               std::vector<size_t> *const ends) {
+        if (end - begin <= size) {
+                ends->push_back(end);
+                return;
+        }
+
+        double min[3] = { INFINITY, INFINITY, INFINITY };
+        double max[3] = { -INFINITY, -INFINITY, -INFINITY };
+        for (size_t i = begin; i < end; i++) {
+                for (size_t j = 0; j < 3; j++) {
+                        min[j] = std::min(min[j], spheres[i].position[j]);
+                        max[j] = std::max(max[j], spheres[i].position[j]);
+                }
+        }
+
+        size_t axis = 0;
+        for (size_t j = 1; j < 3; j++)
+                if (max[j] - min[j] > max[axis] - min[axis])
+                        axis = j;
+
+        const size_t middle = begin + (end - begin) / 2;
+        std::nth_element(spheres + begin, spheres + middle, spheres + end,
+                         [axis](const SphereRecord &a, const SphereRecord &b) {
+                                 return a.position[axis] < b.position[axis];
+                         });
+
+        partition(spheres, begin, middle, size, ends);
+        partition(spheres, middle, end, size, ends);
+}
+
+// Write an array of records, after padding up to its offset.
+template <typename T>
+void write(std::ofstream &out, const Array &array, const T *const data) {
+        static const char zeros[alignment] = {};
+        const auto pos = static_cast<uint64_t>(out.tellp());
+
+        out.write(zeros, static_cast<std::streamsize>(array.offset - pos));
+        out.write(reinterpret_cast<const char *>(data),
+                  static_cast<std::streamsize>(array.count * sizeof(T)));
+}
+
+}  // namespace
+
+Storage::~Storage() {
+        munmap(data, size);
+}
+
+}  // namespace sceneformat
+
+SceneFile *SceneFile::loadBinary(const std::string &path,
+                                 std::string *const error,
+                                 const size_t cacheSize) {
+        using sceneformat::CheckerBoardRecord;
+        using sceneformat::ChunkRecord;
+        using sceneformat::LightRecord;
+        using sceneformat::PlaneRecord;
+        using sceneformat::SphereRecord;
+        using sceneformat::contains;
+        using sceneformat::records;
+
+        const int fd = open(path.c_str(), O_RDONLY);
+        struct stat info;
+
+        if (fd < 0 || fstat(fd, &info)) {
+                *error = path + ": " + strerror(errno);
+                if (fd >= 0)
+                        close(fd);
+                return nullptr;
+        }
+
+        const auto size = static_cast<size_t>(info.st_size);
+        if (size < sizeof(sceneformat::Header)) {
+                close(fd);
+                *error = path + ": truncated binary scene";
+                return nullptr;
+        }
+
+        // Pre-fault the whole file, since all of it will be read,
+        // unless it may be loaded out of core.
+#ifdef MAP_POPULATE
+        const int flags = cacheSize ? MAP_PRIVATE
+                        : MAP_PRIVATE | MAP_POPULATE;
+#else
+        const int flags = MAP_PRIVATE;
+#endif
+        void *const data = mmap(nullptr, size, PROT_READ, flags, fd, 0);
+
+        if (data == MAP_FAILED) {
+                *error = path + ": " + strerror(errno);
+                close(fd);
+                return nullptr;
+        }
+
+        auto *const storage = new sceneformat::Storage(data, size);
+
+        const auto &header = *static_cast<const sceneformat::Header *>(data);
+        const auto fail = [&](const char *const message) {
+                delete storage;
+                close(fd);
+                *error = path + ": " + message;
+                return nullptr;
+        };
+
+        if (header.byteOrderMark != sceneformat::byteOrderMark)
+                return fail("binary scene has a foreign byte order");
+        if (header.version != sceneformat::version)
+                return fail("unsupported binary scene version");
+        if (!contains(size, header.materials,
+                      sizeof(sceneformat::MaterialRecord)) ||
+            !contains(size, header.spheres, sizeof(SphereRecord)) ||
+            !contains(size, header.planes, sizeof(PlaneRecord)) ||
+            !contains(size, header.checkerBoards,
+                      sizeof(CheckerBoardRecord)) ||
+            !contains(size, header.lights, sizeof(LightRecord)) ||
+            !contains(size, header.chunks, sizeof(ChunkRecord)) ||
+            !contains(size, header.path, sizeof(char)))
+                return fail("truncated binary scene");
+
+        // Each chunk must be a run of the spheres array.
+        const auto *const chunks = records<ChunkRecord>(data, header.chunks);
+        for (size_t i = 0; i < header.chunks.count; i++) {
+                const auto &run = chunks[i].spheres;
+                const auto start = header.spheres.offset;
+
+                if (run.offset < start ||
+                    (run.offset - start) % sizeof(SphereRecord) ||
+                    run.count > header.spheres.count -
+                    (run.offset - start) / sizeof(SphereRecord))
+                        return fail("invalid chunk");
+        }
+
+        // Spheres are loaded on demand if the file has chunks and a
+        // cache is requested.
+        const bool outOfCore = cacheSize && header.chunks.count;
+        const size_t sphereCount = outOfCore ? 0 : header.spheres.count;
+
+        // Materials are used in place.
+        const auto materialCount = header.materials.count;
+        if (materialCount > UINT32_MAX)
+                return fail("too many materials");
+        Materials table(records<Material>(data, header.materials),
+                        materialCount);
+
+        const auto *const spheres = records<SphereRecord>(data, header.spheres);
+        const auto *const planes = records<PlaneRecord>(data, header.planes);
+        const auto *const checkerBoards = records<CheckerBoardRecord>(
+            data, header.checkerBoards);
+        const auto *const lights = records<LightRecord>(data, header.lights);
+
+        // Check material references before constructing anything.
+        for (size_t i = 0; i < sphereCount; i++)
+                if (spheres[i].material >= materialCount)
+                        return fail("invalid material index");
+        for (size_t i = 0; i < header.planes.count; i++)
+                if (planes[i].material >= materialCount)
+                        return fail("invalid material index");
+        for (size_t i = 0; i < header.checkerBoards.count; i++)
+                if (checkerBoards[i].material1 >= materialCount ||
+                    checkerBoards[i].material2 >= materialCount)
+                        return fail("invalid material index");
+
+        // Objects and lights are polymorphic, so cannot be used in
+        // place. They are constructed contiguously in an arena.
+        Arena arena;
+        std::vector<const Object *> objects;
+        std::vector<const Light *> sources;
+        objects.reserve(sphereCount + header.planes.count +
+                        header.checkerBoards.count);
+        sources.reserve(header.lights.count);
+
+        for (size_t i = 0; i < sphereCount; i++) {
+                const auto &record = spheres[i];
+                objects.push_back(arena.make<Sphere>(
+                    sceneformat::vector(record.position), record.radius,
+                    static_cast<MaterialIndex>(record.material)));
+        }
+
+        for (size_t i = 0; i < header.planes.count; i++) {
+                const auto &record = planes[i];
+                objects.push_back(arena.make<Plane>(
+                    sceneformat::vector(record.position),
+                    sceneformat::vector(record.direction),
+                    static_cast<MaterialIndex>(record.material)));
+        }
+
+        for (size_t i = 0; i < header.checkerBoards.count; i++) {
+                const auto &record = checkerBoards[i];
+                objects.push_back(arena.make<CheckerBoard>(
+                    sceneformat::vector(record.position),
+                    sceneformat::vector(record.direction),
+                    record.checkerWidth,
+                    static_cast<MaterialIndex>(record.material1),
+                    static_cast<MaterialIndex>(record.material2)));
+        }
+
+        for (size_t i = 0; i < header.lights.count; i++) {
+                const auto &record = lights[i];
+                sources.push_back(arena.make<SoftLight>(
+                    sceneformat::vector(record.position),
+                    sceneformat::colour(record.colour), record.radius,
+                    std::max(record.samples, static_cast<uint64_t>(1))));
+        }
+
+        const auto &camera = header.camera;
+        const auto &settings = header.settings;
+        const auto *const chars = records<char>(data, header.path);
+
+        SceneFile *const file = new SceneFile();
+        file->storage = storage;
+
+        if (outOfCore) {
+                // Pad the bounds to allow for rounding errors in
+                // intersection tests.
+                const Vector padding(ScalarPrecision, ScalarPrecision,
+                                     ScalarPrecision);
+                std::vector<ChunkCache::Entry> entries;
+                entries.reserve(header.chunks.count);
+
+                for (size_t i = 0; i < header.chunks.count; i++) {
+                        const auto &chunk = chunks[i];
+                        entries.push_back({
+                                sceneformat::vector(chunk.min) - padding,
+                                sceneformat::vector(chunk.max) + padding,
+                                chunk.spheres.offset,
+                                (chunk.spheres.offset -
+                                 header.spheres.offset) / sizeof(SphereRecord),
+                                chunk.spheres.count
+                        });
+                }
+
+                // The cache takes ownership of the file descriptor.
+                file->chunks = new ChunkCache(fd, std::move(entries),
+                                              cacheSize, materialCount);
+        } else {
+                close(fd);
+        }
+
+        file->scene = new Scene(std::move(arena), std::move(table),
+                                Objects(objects.begin(), objects.end()),
+                                Lights(sources.begin(), sources.end()));
+        file->camera = new Camera(sceneformat::vector(camera.position),
+                                  sceneformat::vector(camera.lookAt),
+                                  camera.width, camera.height,
+                                  Lens(camera.focalLength, camera.aperture,
+                                       camera.focus));
+        file->rayDepth = settings.rayDepth;
+        file->dofSamples = settings.dofSamples;
+        file->scale = settings.scale;
+        file->saturation = settings.saturation;
+        file->gamma = sceneformat::colour(settings.gamma);
+        file->path = std::string(chars, header.path.count);
+
+        return file;
+}
+
+bool SceneFile::write(const std::string &destination,
+                      std::string *const error,
+                      const size_t chunkSize) const {
+        using sceneformat::store;
+
+        std::vector<sceneformat::MaterialRecord> materials;
+        std::vector<sceneformat::SphereRecord> spheres;
+        std::vector<sceneformat::PlaneRecord> planes;
+        std::vector<sceneformat::CheckerBoardRecord> checkerBoards;
+        std::vector<sceneformat::LightRecord> lights;
+        std::vector<sceneformat::ChunkRecord> chunkRecords;
+
+        for (const auto &material : scene->materials) {
+                sceneformat::MaterialRecord record;
+                store(record.colour, material.colour);
+                record.ambient = material.ambient;
+                record.diffuse = material.diffuse;
+                record.specular = material.specular;
+                record.shininess = material.shininess;
+                record.reflectivity = material.reflectivity;
+                materials.push_back(record);
+        }
+
+        for (auto object : scene->objects) {
+                // Test for checkerboards first, since they are planes.
+                if (auto board = dynamic_cast<const CheckerBoard *>(object)) {
+                        sceneformat::CheckerBoardRecord record;
+                        store(record.position, board->position);
+                        store(record.direction, board->direction);
+                        record.checkerWidth = board->checkerWidth;
+                        record.material1 = board->material1;
+                        record.material2 = board->material2;
+                        checkerBoards.push_back(record);
+                } else if (auto plane = dynamic_cast<const Plane *>(object)) {
+                        sceneformat::PlaneRecord record;
+                        store(record.position, plane->position);
+                        store(record.direction, plane->direction);
+                        record.material = plane->material;
+                        planes.push_back(record);
+                } else if (auto sphere = dynamic_cast<const Sphere *>(object)) {
+                        sceneformat::SphereRecord record;
+                        store(record.position, sphere->position);
+                        record.radius = sphere->radius;
+                        record.material = sphere->material;
+                        spheres.push_back(record);
+                } else {
+                        *error = destination + ": unsupported object type";
+                        return false;
+                }
+        }
+
+        for (auto light : scene->lights) {
+                auto soft = dynamic_cast<const SoftLight *>(light);
+                if (!soft) {
+                        *error = destination + ": unsupported light type";
+                        return false;
+                }
+
+                sceneformat::LightRecord record;
+                store(record.position, soft->position);
+                store(record.colour, soft->colour);
+                record.radius = soft->radius;
+                record.samples = soft->samples;
+                lights.push_back(record);
+        }
+
+        // Partition the spheres into chunks, if required.
+        std::vector<size_t> ends;
+        if (chunkSize && spheres.size())
+                sceneformat::partition(spheres.data(), 0, spheres.size(),
+                                       chunkSize, &ends);
+
+        sceneformat::Header header;
+        std::memset(&header, 0, sizeof(header));
+        std::copy(sceneformat::magic,
+                  sceneformat::magic + sizeof(sceneformat::magic),
+                  header.magic);
+        header.version = sceneformat::version;
+        header.byteOrderMark = sceneformat::byteOrderMark;
+
+        store(header.camera.position, camera->position);
+        store(header.camera.lookAt, camera->lookAt);
+        header.camera.width = camera->width;
+        header.camera.height = camera->height;
+        header.camera.focalLength = camera->lens.focalLength;
+        header.camera.aperture = camera->lens.aperture.radius;
+        header.camera.focus = camera->lens.focus;
+
+        header.settings.rayDepth = rayDepth;
+        header.settings.dofSamples = dofSamples;
+        header.settings.scale = scale;
+        header.settings.saturation = saturation;
+        store(header.settings.gamma, gamma);
+
+        uint64_t end = sizeof(header);
+        sceneformat::place<sceneformat::MaterialRecord>(
+            &header.materials, materials.size(), &end);
+        sceneformat::place<sceneformat::SphereRecord>(
+            &header.spheres, spheres.size(), &end);
+        sceneformat::place<sceneformat::PlaneRecord>(
+            &header.planes, planes.size(), &end);
+        sceneformat::place<sceneformat::CheckerBoardRecord>(
+            &header.checkerBoards, checkerBoards.size(), &end);
+        sceneformat::place<sceneformat::LightRecord>(
+            &header.lights, lights.size(), &end);
+        sceneformat::place<sceneformat::ChunkRecord>(
+            &header.chunks, ends.size(), &end);
+        sceneformat::place<char>(&header.path, path.size(), &end);
+
+        // Record the bounds and location of each chunk.
+        size_t begin = 0;
+        for (const auto chunkEnd : ends) {
+                sceneformat::ChunkRecord record;
+
+                for (size_t j = 0; j < 3; j++) {
+                        record.min[j] = INFINITY;
+                        record.max[j] = -INFINITY;
+                }
+                for (size_t i = begin; i < chunkEnd; i++) {
+                        const auto &sphere = spheres[i];
+                        for (size_t j = 0; j < 3; j++) {
+                                record.min[j] = std::min(
+                                    record.min[j],
+                                    sphere.position[j] - sphere.radius);
+                                record.max[j] = std::max(
+                                    record.max[j],
+                                    sphere.position[j] + sphere.radius);
+                        }
+                }
+
+                record.spheres.offset = header.spheres.offset +
+                                begin * sizeof(sceneformat::SphereRecord);
+                record.spheres.count = chunkEnd - begin;
+                chunkRecords.push_back(record);
+                begin = chunkEnd;
+        }
+
+        // The stream's buffer is large, so keep it off the stack.
+        const auto out = std::make_unique<std::ofstream>(
+            destination, std::ios::binary | std::ios::trunc);
+        out->write(reinterpret_cast<const char *>(&header), sizeof(header));
+        sceneformat::write(*out, header.materials, materials.data());
+        sceneformat::write(*out, header.spheres, spheres.data());
+        sceneformat::write(*out, header.planes, planes.data());
+        sceneformat::write(*out, header.checkerBoards, checkerBoards.data());
+        sceneformat::write(*out, header.lights, lights.data());
+        sceneformat::write(*out, header.chunks, chunkRecords.data());
+        sceneformat::write(*out, header.path, path.data());
+        out->close();
+
+        if (!*out) {
+                *error = destination + ": could not write file";
+                return false;
+        }
+
+        return true;
+}
+
+}  // namespace rt
@@ -0,0 +1,259 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "rt/scenegen.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "rt/lights.h"
+
+namespace rt {
+
+namespace scenegen {
+
+namespace {
+
+// Film size, and a focal length which gives a 53 degree field of
+// view.
+static const Scalar filmSize = 36;
+static const Scalar focalLength = 36;
+
+// Sphere radius, and the average distance between sphere centres.
+// These must be large relative to the film, since primary rays start
+// from points on the film.
+static const Scalar radius = 10;
+static const Scalar spacing = 40;
+
+// The number of random sphere materials.
+static const size_t paletteSize = 8;
+
+// The number of spheres in Layout::Lights.
+static const size_t lightsLayoutSpheres = 16;
+
+// Accumulates the contents of a scene.
+class Builder {
+ public:
+        explicit Builder(const Parameters &_parameters)
+                : parameters(_parameters),
+                  // Zero is a fixed point of the generator.
+                  random(0, 1, _parameters.seed * 2 + 1) {
+                for (size_t i = 0; i < paletteSize; i++)
+                        palette.push_back(material(
+                            Colour(uniform(.2, 1), uniform(.2, 1),
+                                   uniform(.2, 1)),
+                            0, uniform(.5, 1), uniform(0, .8),
+                            uniform(5, 100), uniform(0, .3)));
+        }
+
+        // Return a random number in the range [min,max].
+        Scalar uniform(const Scalar min, const Scalar max) {
+                return min + (max - min) * random();
+        }
+
+        MaterialIndex material(const Colour &colour,
+                               const Scalar ambient,
+                               const Scalar diffuse,
+                               const Scalar specular,
+                               const Scalar shininess,
+                               const Scalar reflectivity) {
+                return materials.add(Material(colour, ambient, diffuse,
+                                              specular, shininess,
+                                              reflectivity));
+        }
+
+        // Add a sphere with a random material from the palette.
+        void sphere(const Vector &position) {
+                const auto i = std::min(
+                    static_cast<size_t>(random() * paletteSize),
+                    paletteSize - 1);
+                objects.push_back(arena.make<Sphere>(position, radius,
+                                                     palette[i]));
+        }
+
+        void plane(const Vector &position, const Vector &direction,
+                   const MaterialIndex material) {
+                objects.push_back(arena.make<Plane>(position, direction,
+                                                    material));
+        }
+
+        // Add a square grid of spheres resting on the plane y = 0.
+        void grid(const size_t count) {
+                const auto side = static_cast<size_t>(
+                    std::ceil(std::sqrt(count)));
+                const Scalar offset = (side - 1) * spacing / 2;
+
+                for (size_t i = 0; i < count; i++)
+                        sphere(Vector(i % side * spacing - offset, radius,
+                                      i / side * spacing - offset));
+        }
+
+        // Add a checkerboard floor at height y.
+        void floor(const Scalar y) {
+                objects.push_back(arena.make<CheckerBoard>(
+                    Vector(0, y, 0), Vector(0, 1, 0), spacing,
+                    material(Colour(0xffffff), .1, .8, 0, 10, 0),
+                    material(Colour(0x404040), .1, .8, 0, 10, 0)));
+        }
+
+        // Scatter soft lights over a square of the given size, at
+        // height y. Light colours are scaled so that the total
+        // intensity is constant.
+        void lights(const size_t count, const Scalar size, const Scalar y) {
+                const auto intensity = static_cast<float>(1. / count);
+                const Scalar lightRadius = parameters.lightSamples > 1 ?
+                                size / 20 : 0;
+
+                for (size_t i = 0; i < count; i++)
+                        sources.push_back(arena.make<SoftLight>(
+                            Vector(uniform(-size, size) / 2, y,
+                                   uniform(-size, size) / 2),
+                            Colour(intensity, intensity, intensity),
+                            lightRadius, parameters.lightSamples));
+        }
+
+        // Transfer the scene to a scene file.
+        SceneFile *build(const Vector &position, const Vector &lookAt) {
+                const Camera *const camera = new Camera(
+                    position, lookAt, filmSize, filmSize,
+                    Lens(focalLength, 0, 1));
+                const Scene *const scene = new Scene(
+                    std::move(arena), std::move(materials),
+                    Objects(objects.begin(), objects.end()),
+                    Lights(sources.begin(), sources.end()));
+                SceneFile *const file = new SceneFile(scene, camera);
+
+                file->rayDepth = parameters.rayDepth;
+                file->scale = parameters.scale;
+                return file;
+        }
+
+ private:
+        const Parameters &parameters;
+        UniformDistribution random;
+        Arena arena;
+        Materials materials;
+        std::vector<MaterialIndex> palette;
+        std::vector<const Object *> objects;
+        std::vector<const Light *> sources;
+};
+
+// Return the side of a cube which holds "count" randomly placed
+// spheres at the average spacing.
+Scalar cube(const size_t count) {
+        return std::max(spacing * std::cbrt(count), 4 * spacing);
+}
+
+SceneFile *spheres(const Parameters &parameters) {
+        Builder builder(parameters);
+        const Scalar size = cube(parameters.count);
+
+        for (size_t i = 0; i < parameters.count; i++)
+                builder.sphere(Vector(builder.uniform(-size, size) / 2,
+                                      builder.uniform(0, size),
+                                      builder.uniform(-size, size) / 2));
+        builder.floor(-radius);
+        builder.lights(parameters.lights, size, 2 * size);
+
+        return builder.build(Vector(0, size, -1.6 * size),
+                             Vector(0, size / 3, 0));
+}
+
+SceneFile *grid(const Parameters &parameters) {
+        Builder builder(parameters);
+        const Scalar size = std::max(
+            spacing * std::ceil(std::sqrt(parameters.count)), 4 * spacing);
+
+        builder.grid(parameters.count);
+        builder.floor(0);
+        builder.lights(parameters.lights, size, size);
+
+        return builder.build(Vector(0, .8 * size, -size), Vector(0, 0, 0));
+}
+
+SceneFile *lights(const Parameters &parameters) {
+        Builder builder(parameters);
+        const Scalar size = 4 * spacing;
+
+        builder.grid(lightsLayoutSpheres);
+        builder.floor(0);
+        builder.lights(parameters.count, 2 * size, size);
+
+        return builder.build(Vector(0, .8 * size, -size), Vector(0, 0, 0));
+}
+
+SceneFile *mirrors(const Parameters &parameters) {
+        Builder builder(parameters);
+        const Scalar size = cube(parameters.count);
+        const Scalar wall = size / 2 + radius;
+        const MaterialIndex mirror = builder.material(
+            Colour(0xffffff), 0, 0, 1, 400, .9);
+
+        for (size_t i = 0; i < parameters.count; i++)
+                builder.sphere(Vector(builder.uniform(-size, size) / 2,
+                                      builder.uniform(0, size),
+                                      builder.uniform(0, size)));
+        builder.floor(-radius);
+        builder.lights(parameters.lights, size, 2 * size);
+
+        // Infinite parallel mirrors, so that reflections only end
+        // when they hit a sphere or the floor.
+        builder.plane(Vector(-wall, 0, 0), Vector(1, 0, 0), mirror);
+        builder.plane(Vector(wall, 0, 0), Vector(-1, 0, 0), mirror);
+
+        return builder.build(Vector(-size / 4, size / 2, -size),
+                             Vector(wall, size / 2, size / 2));
+}
+
+}  // namespace
+
+bool layout(const std::string &name, Layout *const out) {
+        if (name == "spheres")
+                *out = Layout::Spheres;
+        else if (name == "grid")
+                *out = Layout::Grid;
+        else if (name == "lights")
+                *out = Layout::Lights;
+        else if (name == "mirrors")
+                *out = Layout::Mirrors;
+        else
+                return false;
+
+        return true;
+}
+
+SceneFile *generate(const Parameters &parameters) {
+        switch (parameters.layout) {
+        case Layout::Grid:
+                return grid(parameters);
+        case Layout::Lights:
+                return lights(parameters);
+        case Layout::Mirrors:
+                return mirrors(parameters);
+        case Layout::Spheres:
+        default:
+                return spheres(parameters);
+        }
+}
+
+}  // namespace scenegen
+
+}  // namespace rt
@@ -0,0 +1,121 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "rt/timeline.h"
+
+#include <cstdio>
+
+namespace rt {
+
+namespace profiling {
+
+// The active timeline, if any.
+static std::atomic<Timeline *> activeTimeline(nullptr);
+
+Timeline::Timeline()
+                : epoch(std::chrono::steady_clock::now()), threads(0),
+                  buffers([this]() { return Buffer{threads++, {}}; }) {}
+
+void Timeline::record(const char *const name,
+                      const Time start,
+                      const Time end,
+                      const uint64_t index,
+                      const uint64_t count) {
+        buffers.local().events.push_back({name, start, end, index, count});
+}
+
+size_t Timeline::size() const {
+        size_t n = 0;
+        for (const auto &buffer : buffers)
+                n += buffer.events.size();
+        return n;
+}
+
+Timeline *Timeline::active() {
+        return activeTimeline.load(std::memory_order_relaxed);
+}
+
+std::ostream &operator<<(std::ostream &out, const Timeline &timeline) {
+        // Return the microseconds from the start of the timeline to a
+        // time.
+        const auto microseconds = [&](const Timeline::Time time) {
+                return std::chrono::duration<double, std::micro>(
+                    time - timeline.epoch).count();
+        };
+        char buffer[64];
+
+        out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+
+        bool first = true;
+        for (const auto &thread : timeline.buffers) {
+                out << (first ? "\n" : ",\n")
+                    << "  {\"name\": \"thread_name\", \"ph\": \"M\", "
+                    << "\"pid\": 1, \"tid\": " << thread.thread
+                    << ", \"args\": {\"name\": \"thread "
+                    << thread.thread << "\"}}";
+                first = false;
+
+                for (const auto &event : thread.events) {
+                        snprintf(buffer, sizeof(buffer),
+                                 "\"ts\": %.3f, \"dur\": %.3f",
+                                 microseconds(event.start),
+                                 microseconds(event.end) -
+                                 microseconds(event.start));
+                        out << ",\n  {\"name\": \"" << event.name
+                            << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+                            << thread.thread << ", " << buffer;
+                        if (event.count)
+                                out << ", \"args\": {\"index\": "
+                                    << event.index << ", \"count\": "
+                                    << event.count << "}";
+                        out << "}";
+                }
+        }
+
+        out << "\n]}\n";
+
+        return out;
+}
+
+Tracing::Tracing(Timeline *const timeline)
+                : previous(activeTimeline.exchange(timeline)) {}
+
+Tracing::~Tracing() {
+        activeTimeline = previous;
+}
+
+Span::Span(const char *const _name,
+           const uint64_t _index,
+           const uint64_t _count)
+                : timeline(Timeline::active()), name(_name), index(_index),
+                  count(_count) {
+        if (timeline)
+                start = std::chrono::steady_clock::now();
+}
+
+Span::~Span() {
+        if (timeline)
+                timeline->record(name, start,
+                                 std::chrono::steady_clock::now(), index,
+                                 count);
+}
+
+}  // namespace profiling
+
+}  // namespace rt
@@ -0,0 +1,88 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Compare a rendered image against a reference render, printing
+// objective quality metrics and optionally writing a per-pixel error
+// heatmap.
+//
+// Usage: rtcompare <reference.ppm> <image.ppm> [heatmap.ppm]
+
+#include <cstdio>
+#include <fstream>
+
+#include "rt/image.h"
+#include "rt/quality.h"
+
+// Read an image from path, or print an error and return nullptr.
+static rt::DynamicImage *read(const char *const path) {
+        std::ifstream in(path, std::ios::binary);
+        rt::DynamicImage *const image = rt::image::readPPM(in);
+
+        if (image == nullptr)
+                fprintf(stderr, "fatal: could not read image '%s'\n", path);
+
+        return image;
+}
+
+int main(int argc, char **argv) {
+        if (argc < 3 || argc > 4) {
+                fprintf(stderr, "Usage: %s <reference.ppm> <image.ppm> "
+                        "[heatmap.ppm]\n", argv[0]);
+                return 1;
+        }
+
+        // Read input images.
+        rt::DynamicImage *const reference = read(argv[1]);
+        rt::DynamicImage *const image = read(argv[2]);
+        if (reference == nullptr || image == nullptr)
+                return 1;
+
+        if (reference->width != image->width ||
+            reference->height != image->height) {
+                fprintf(stderr, "fatal: image dimensions differ "
+                        "(%lux%lu vs %lux%lu)\n",
+                        reference->width, reference->height,
+                        image->width, image->height);
+                return 1;
+        }
+
+        // Compute and print metrics.
+        const rt::quality::Comparison result =
+                        rt::quality::compare(*reference, *image);
+
+        printf("MSE:\t\t%.8f\n", result.mse);
+        printf("PSNR:\t\t%.3f dB\n", result.psnr);
+        printf("SSIM:\t\t%.6f\n", result.ssim);
+        printf("Max error:\t%.6f\n", result.maxError);
+
+        // Write heatmap, if requested.
+        if (argc == 4) {
+                rt::DynamicImage heatmap(image->width, image->height);
+                rt::quality::errorMap(*reference, *image, &heatmap);
+
+                std::ofstream out(argv[3]);
+                out << heatmap;
+        }
+
+        delete reference;
+        delete image;
+
+        return 0;
+}
@@ -0,0 +1,103 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Convert a scene file to the binary scene format, which rtrender
+// loads by memory mapping.
+//
+// Usage: rtconvert [-c <n>] <scene.rt> <scene.rtb>
+//
+// With "-c <n>", spheres are partitioned into spatial chunks of at
+// most n spheres, which "rtrender --cache" loads on demand.
+
+#include <getopt.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "rt/scenefile.h"
+
+static void usage(const char *const name) {
+        fprintf(stderr,
+                "Usage: %s [options] <scene.rt> <scene.rtb>\n"
+                "\n"
+                "Options:\n"
+                "  -c, --chunk-size <n>     Partition spheres into "
+                "chunks of at most n\n"
+                "  -h, --help               Show this message\n",
+                name);
+}
+
+int main(int argc, char **argv) {
+        static const struct option options[] = {
+                {"chunk-size", required_argument, nullptr, 'c'},
+                {"help",       no_argument,       nullptr, 'h'},
+                {nullptr,      0,                 nullptr, 0}
+        };
+
+        size_t chunkSize = 0;
+
+        int c;
+        while ((c = getopt_long(argc, argv, "c:h", options,
+                                nullptr)) != -1) {
+                switch (c) {
+                case 'c': {
+                        char *end;
+                        chunkSize = strtoul(optarg, &end, 10);
+                        if (!*optarg || *end || !chunkSize ||
+                            optarg[0] == '-') {
+                                fprintf(stderr, "fatal: invalid value '%s' "
+                                        "for --chunk-size\n", optarg);
+                                return 1;
+                        }
+                        break;
+                }
+                case 'h':
+                        usage(argv[0]);
+                        return 0;
+                default:
+                        usage(argv[0]);
+                        return 1;
+                }
+        }
+
+        if (optind != argc - 2) {
+                usage(argv[0]);
+                return 1;
+        }
+
+        std::string error;
+        rt::SceneFile *const file = rt::SceneFile::load(argv[optind], &error);
+        if (file == nullptr) {
+                fprintf(stderr, "fatal: %s\n", error.c_str());
+                return 1;
+        }
+
+        const bool written = file->write(argv[optind + 1], &error, chunkSize);
+        if (written)
+                printf("%lu materials, %lu objects, %lu lights\n",
+                       file->scene->materials.size(),
+                       file->scene->objects.size(),
+                       file->scene->lights.size());
+        else
+                fprintf(stderr, "fatal: %s\n", error.c_str());
+
+        delete file;
+        return written ? 0 : 1;
+}
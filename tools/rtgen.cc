@@ -0,0 +1,137 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Generate a synthetic scene for scaling benchmarks, and write it in
+// the binary scene format.
+//
+// Usage: rtgen [options] <scene.rtb>
+//
+// Run with --help for a list of options.
+
+#include <getopt.h>
+
+#include <cstdio>
+#include <string>
+
+#include "rt/options.h"
+#include "rt/scenegen.h"
+
+using rt::options::count;
+
+static void usage(const char *const name) {
+        fprintf(stderr,
+                "Usage: %s [options] <scene.rtb>\n"
+                "\n"
+                "Options:\n"
+                "  -l, --layout <name>        One of: spheres, grid, "
+                "lights, mirrors\n"
+                "  -n, --count <n>            Number of primitives, or "
+                "lights for 'lights'\n"
+                "  -L, --lights <n>           Number of soft lights\n"
+                "  -S, --light-samples <n>    Samples per soft light\n"
+                "  -r, --ray-depth <n>        Maximum reflection depth\n"
+                "  -s, --scale <n>            Image scale factor, "
+                "relative to a 36x36 film\n"
+                "  -e, --seed <n>             Random seed\n"
+                "  -c, --chunk-size <n>       Partition spheres into "
+                "chunks of at most n\n"
+                "  -h, --help                 Show this message\n",
+                name);
+}
+
+int main(int argc, char **argv) {
+        static const struct option options[] = {
+                {"layout",        required_argument, nullptr, 'l'},
+                {"count",         required_argument, nullptr, 'n'},
+                {"lights",        required_argument, nullptr, 'L'},
+                {"light-samples", required_argument, nullptr, 'S'},
+                {"ray-depth",     required_argument, nullptr, 'r'},
+                {"scale",         required_argument, nullptr, 's'},
+                {"seed",          required_argument, nullptr, 'e'},
+                {"chunk-size",    required_argument, nullptr, 'c'},
+                {"help",          no_argument,       nullptr, 'h'},
+                {nullptr,         0,                 nullptr, 0}
+        };
+
+        rt::scenegen::Parameters parameters;
+        size_t chunkSize = 0;
+
+        int c;
+        while ((c = getopt_long(argc, argv, "l:n:L:S:r:s:e:c:h",
+                                options, nullptr)) != -1) {
+                switch (c) {
+                case 'l':
+                        if (!rt::scenegen::layout(optarg,
+                                                  &parameters.layout)) {
+                                fprintf(stderr, "fatal: unknown layout "
+                                        "'%s'\n", optarg);
+                                return 1;
+                        }
+                        break;
+                case 'n':
+                        parameters.count = count("--count", optarg);
+                        break;
+                case 'L':
+                        parameters.lights = count("--lights", optarg);
+                        break;
+                case 'S':
+                        parameters.lightSamples = count("--light-samples",
+                                                        optarg);
+                        break;
+                case 'r':
+                        parameters.rayDepth = count("--ray-depth", optarg);
+                        break;
+                case 's':
+                        parameters.scale = count("--scale", optarg);
+                        break;
+                case 'e':
+                        parameters.seed = count("--seed", optarg, true);
+                        break;
+                case 'c':
+                        chunkSize = count("--chunk-size", optarg);
+                        break;
+                case 'h':
+                        usage(argv[0]);
+                        return 0;
+                default:
+                        usage(argv[0]);
+                        return 1;
+                }
+        }
+
+        if (optind != argc - 1) {
+                usage(argv[0]);
+                return 1;
+        }
+
+        rt::SceneFile *const file = rt::scenegen::generate(parameters);
+
+        std::string error;
+        const bool written = file->write(argv[optind], &error, chunkSize);
+        if (written)
+                printf("%lu materials, %lu objects, %lu lights\n",
+                       file->scene->materials.size(),
+                       file->scene->objects.size(),
+                       file->scene->lights.size());
+        else
+                fprintf(stderr, "fatal: %s\n", error.c_str());
+
+        delete file;
+        return written ? 0 : 1;
+}
@@ -0,0 +1,317 @@
+/* -*- c-basic-offset: 8; -*-
+ *
+ * Copyright (C) 2015 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Render a scene file.
+//
+// Usage: rtrender [options] <scene.rt>
+//
+// Settings from the scene file's [Renderer] section may be overridden
+// on the command line. Run with --help for a list of options.
+
+#include <getopt.h>
+
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "rt/chunks.h"
+#include "rt/denoise.h"
+#include "rt/estimate.h"
+#include "rt/options.h"
+#include "rt/progress.h"
+#include "rt/rt.h"
+#include "rt/scenefile.h"
+#include "rt/timeline.h"
+
+using rt::options::count;
+
+static void usage(const char *const name) {
+        fprintf(stderr,
+                "Usage: %s [options] <scene.rt>\n"
+                "\n"
+                "Options:\n"
+                "  -o, --output <path>      Output image path\n"
+                "  -s, --scale <n>          Image scale factor, relative "
+                "to the film size\n"
+                "  -d, --dof-samples <n>    Number of depth of field "
+                "samples\n"
+                "  -r, --ray-depth <n>      Maximum reflection depth\n"
+                "  -p, --preview <n>        Write a preview at 1/n "
+                "resolution first\n"
+                "  -g, --guide              Take a single lens and light "
+                "sample for pixels\n"
+                "                           which the preview finds "
+                "free of noise\n"
+                "  -a, --aov                Write auxiliary outputs\n"
+                "  -n, --denoise            Denoise soft shadows, "
+                "for pinhole cameras\n"
+                "  -c, --cache <MB>         Load the spheres of a chunked "
+                "binary scene\n"
+                "                           on demand, into a cache of "
+                "this size\n"
+                "  -e, --estimate <n>       Print scene statistics and "
+                "a cost estimate\n"
+                "                           from n sampled pixels, "
+                "instead of rendering\n"
+                "  -j, --report <path>      Write a JSON report of the "
+                "render\n"
+                "  -t, --trace <path>       Write a timeline of the "
+                "render's threads, in\n"
+                "                           Chrome trace format\n"
+                "  -P, --perf               Count hardware events "
+                "during each phase\n"
+                "  -l, --progress <s>       Write progress to stderr "
+                "as JSON lines, every\n"
+                "                           s seconds\n"
+                "  -h, --help               Show this message\n",
+                name);
+}
+
+// Print the statistics of a scene, and an estimate of the cost of
+// rendering it from "samples" sampled pixels.
+static void estimate(const rt::SceneFile &file,
+                     const rt::Renderer &renderer,
+                     const size_t samples) {
+        const rt::SceneStats stats = rt::statistics(*file.scene,
+                                                    file.chunks);
+
+        printf("Scene:\n");
+        printf("\tSpheres:\t\t%lu\n", stats.spheres);
+        printf("\tPlanes:\t\t\t%lu\n", stats.planes);
+        printf("\tCheckerboards:\t\t%lu\n", stats.checkerBoards);
+        if (stats.otherObjects)
+                printf("\tOther objects:\t\t%lu\n", stats.otherObjects);
+        printf("\tMaterials:\t\t%lu\n", stats.materials);
+        printf("\tMirror surfaces:\t%lu (max reflectivity %.2f)\n",
+               stats.mirrors, stats.maxReflectivity);
+        printf("\tLights:\t\t\t%lu (%lu samples per point)\n",
+               stats.lights, stats.lightSamples);
+        printf("\tSphere bounds:\t\t(%g, %g, %g) to (%g, %g, %g)\n",
+               stats.min[0], stats.min[1], stats.min[2],
+               stats.max[0], stats.max[1], stats.max[2]);
+
+        const rt::Estimate cost = rt::estimate(renderer, file.width(),
+                                               file.height(), samples);
+
+        printf("\nEstimate from %lu of %lu pixels (%.3f seconds):\n",
+               cost.sampled, cost.pixels, cost.sampleSeconds);
+        printf("\tSamples per pixel:\t%.2f\n", cost.samplesPerPixel);
+        // Ray counts are only available with instrumentation.
+        if (rt::profiling::instrumentation) {
+                printf("\tTraces per pixel:\t%.2f\n", cost.tracesPerPixel);
+                printf("\tShadow rays per pixel:\t%.2f\n",
+                       cost.shadowRaysPerPixel);
+                printf("\tReflection depth:\t%.2f\n", cost.reflectionDepth);
+                printf("\tTraces:\t\t\t%.3g\n", cost.traces);
+                printf("\tShadow rays:\t\t%.3g\n", cost.shadowRays);
+                printf("\tIntersection tests:\t%.3g\n", cost.intersections);
+        }
+        printf("\tCore seconds:\t\t%.1f\n", cost.seconds);
+}
+
+int main(int argc, char **argv) {
+        static const struct option options[] = {
+                {"output",      required_argument, nullptr, 'o'},
+                {"scale",       required_argument, nullptr, 's'},
+                {"dof-samples", required_argument, nullptr, 'd'},
+                {"ray-depth",   required_argument, nullptr, 'r'},
+                {"preview",     required_argument, nullptr, 'p'},
+                {"guide",       no_argument,       nullptr, 'g'},
+                {"aov",         no_argument,       nullptr, 'a'},
+                {"denoise",     no_argument,       nullptr, 'n'},
+                {"cache",       required_argument, nullptr, 'c'},
+                {"estimate",    required_argument, nullptr, 'e'},
+                {"report",      required_argument, nullptr, 'j'},
+                {"trace",       required_argument, nullptr, 't'},
+                {"perf",        no_argument,       nullptr, 'P'},
+                {"progress",    required_argument, nullptr, 'l'},
+                {"help",        no_argument,       nullptr, 'h'},
+                {nullptr,       0,                 nullptr, 0}
+        };
+
+        // Command line overrides. Zero or empty values use the scene
+        // file's settings.
+        std::string path, reportPath, tracePath;
+        size_t scale = 0, dofSamples = 0, rayDepth = 0, previewScale = 0;
+        size_t cacheSize = 0, estimateSamples = 0, progressInterval = 0;
+        bool guide = false, aov = false, denoise = false, perf = false;
+
+        int c;
+        while ((c = getopt_long(argc, argv, "o:s:d:r:p:ganc:e:j:t:Pl:h",
+                                options, nullptr)) != -1) {
+                switch (c) {
+                case 'o':
+                        path = optarg;
+                        break;
+                case 's':
+                        scale = count("--scale", optarg);
+                        break;
+                case 'd':
+                        dofSamples = count("--dof-samples", optarg);
+                        break;
+                case 'r':
+                        rayDepth = count("--ray-depth", optarg);
+                        break;
+                case 'p':
+                        previewScale = count("--preview", optarg);
+                        break;
+                case 'g':
+                        guide = true;
+                        break;
+                case 'a':
+                        aov = true;
+                        break;
+                case 'n':
+                        denoise = true;
+                        break;
+                case 'c':
+                        cacheSize = count("--cache", optarg) << 20;
+                        break;
+                case 'e':
+                        estimateSamples = count("--estimate", optarg);
+                        break;
+                case 'j':
+                        reportPath = optarg;
+                        break;
+                case 't':
+                        tracePath = optarg;
+                        break;
+                case 'P':
+                        perf = true;
+                        break;
+                case 'l':
+                        progressInterval = count("--progress", optarg);
+                        break;
+                case 'h':
+                        usage(argv[0]);
+                        return 0;
+                default:
+                        usage(argv[0]);
+                        return 1;
+                }
+        }
+
+        if (optind != argc - 1) {
+                usage(argv[0]);
+                return 1;
+        }
+
+        // Record the phases of the run, starting with the scene load,
+        // and a timeline if required.
+        rt::profiling::Phases phases;
+        const rt::profiling::Recording recording(&phases);
+        const std::unique_ptr<rt::profiling::Timeline> timeline(
+            tracePath.size() ? new rt::profiling::Timeline() : nullptr);
+        const rt::profiling::Tracing tracing(timeline.get());
+
+        // Report live progress on stderr if required. The reporting
+        // thread starts before the hardware counters are opened, so
+        // that they do not count it.
+        rt::profiling::Progress progress(
+            static_cast<rt::Scalar>(progressInterval));
+        const rt::profiling::Monitoring monitoring(
+            progressInterval ? &progress : nullptr);
+
+        // Open the hardware counters before any threads are created,
+        // so that they follow the render's worker threads.
+        const std::unique_ptr<const rt::profiling::HardwareCounters> hardware(
+            perf ? new rt::profiling::HardwareCounters() : nullptr);
+        if (hardware && !hardware->available())
+                fprintf(stderr, "warning: hardware counters unavailable "
+                        "(%s)\n", hardware->error().c_str());
+        phases.hardware = hardware.get();
+
+        // Load the scene.
+        std::string error;
+        rt::profiling::Phase load("scene");
+        const std::unique_ptr<rt::SceneFile> file(
+            rt::SceneFile::load(argv[optind], &error, cacheSize));
+        load.end();
+        if (file == nullptr) {
+                fprintf(stderr, "fatal: %s\n", error.c_str());
+                return 1;
+        }
+
+        // Apply overrides.
+        if (path.size())
+                file->path = path;
+        if (scale)
+                file->scale = scale;
+        if (dofSamples)
+                file->dofSamples = dofSamples;
+        if (rayDepth)
+                file->rayDepth = rayDepth;
+
+        // The denoiser's guides record only the first lens sample, so
+        // it blurs depth of field rather than smoothing its noise.
+        if (denoise && file->dofSamples > 1 &&
+            file->camera->lens.aperture.radius > 0)
+                fprintf(stderr, "warning: --denoise smears depth of "
+                        "field\n");
+
+        const std::unique_ptr<const rt::Denoiser> filter(
+            denoise ? new rt::Denoiser() : nullptr);
+        const std::unique_ptr<const rt::Renderer> renderer(
+            file->chunks ?
+            new rt::ChunkedRenderer(*file->scene, *file->chunks,
+                                    file->camera, file->dofSamples,
+                                    file->rayDepth, filter.get()) :
+            new rt::Renderer(*file->scene, file->camera, file->dofSamples,
+                             file->rayDepth, filter.get()));
+
+        if (estimateSamples) {
+                estimate(*file, *renderer, estimateSamples);
+                return 0;
+        }
+
+        const auto image = std::make_unique<rt::DynamicImage>(
+            file->width(), file->height(), file->saturation, file->gamma);
+        const std::unique_ptr<rt::AuxiliaryBuffers> aux(
+            aov ? new rt::AuxiliaryBuffers() : nullptr);
+
+        rt::render(*renderer, file->path, image.get(), aux.get(),
+                   previewScale, guide, reportPath);
+
+        if (timeline) {
+                std::cout << "\nWriting trace '" << tracePath << "' ("
+                          << timeline->size() << " spans)..." << std::endl;
+                *std::make_unique<std::ofstream>(tracePath) << *timeline;
+        }
+
+        if (file->chunks) {
+                const rt::ChunkStats stats = file->chunks->stats();
+
+                printf("Chunk cache: %lu chunks, %.1f%% hit rate, "
+                       "%.1f MB read, %" PRIu64 " loads, %" PRIu64
+                       " evictions, "
+                       "%.1f MB peak\n",
+                       file->chunks->entries.size(), stats.hitRate() * 100,
+                       stats.bytesRead / 1e6, stats.misses, stats.evictions,
+                       stats.peakBytes / 1e6);
+                if (stats.rejected)
+                        fprintf(stderr, "warning: %" PRIu64 " invalid "
+                                "spheres were not loaded\n", stats.rejected);
+        }
+
+        return 0;
+}